@@ -0,0 +1,227 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+/* Chunked bump-pointer arena and interned string pool.
+ *
+ * Everything allocated from an Arena lives until arena_free(), which hands
+ * the chunks back in one go; there is no per-object free.
+ * A StrPool stores each distinct string once, inside an Arena.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct
+{
+    ArenaChunk *head; // chunk being filled
+    ArenaChunk *tail; // oldest chunk, makes arena_merge O(1)
+    size_t used;      // total bytes handed out
+} Arena;
+
+typedef struct
+{
+    Arena *arena;
+    const char **slots;
+    uint32_t *hashes;
+    size_t cap; // power of two
+    size_t cnt;
+} StrPool;
+
+void arena_init(Arena *a);
+
+// 16-byte aligned, NULL only when out of memory
+void *arena_alloc(Arena *a, size_t size);
+
+// align must be a power of two; use 1 for strings so they pack tightly
+void *arena_alloc_align(Arena *a, size_t size, size_t align);
+
+// moves every chunk of src into dst, src is left empty
+void arena_merge(Arena *dst, Arena *src);
+
+void arena_free(Arena *a);
+
+void strpool_init(StrPool *p, Arena *arena);
+
+// copy of s[0..len) owned by the pool's arena; equal strings share storage
+const char *strpool_intern(StrPool *p, const char *s, size_t len);
+
+// drops the lookup table, the strings stay in the arena
+void strpool_free(StrPool *p);
+
+#ifdef ARENA_IMPLEMENTATION
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_CHUNK_SIZE (1 << 20)
+
+struct ArenaChunk
+{
+    ArenaChunk *next;
+    size_t cap;
+    size_t off;
+    _Alignas(16) unsigned char data[];
+};
+
+void arena_init(Arena *a)
+{
+    a->head = NULL;
+    a->tail = NULL;
+    a->used = 0;
+}
+
+void *arena_alloc_align(Arena *a, size_t size, size_t align)
+{
+    ArenaChunk *c = a->head;
+    size_t off = c ? (c->off + align - 1) & ~(align - 1) : 0;
+    if (!c || off > c->cap || c->cap - off < size)
+    {
+        size_t cap = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        c = (ArenaChunk *)malloc(sizeof(ArenaChunk) + cap);
+        if (!c)
+        {
+            fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+            return NULL;
+        }
+        c->cap = cap;
+        c->off = 0;
+        c->next = a->head;
+        if (!a->tail)
+            a->tail = c;
+        a->head = c;
+        off = 0;
+    }
+
+    void *p = c->data + off;
+    c->off = off + size;
+    a->used += size;
+    return p;
+}
+
+void *arena_alloc(Arena *a, size_t size)
+{
+    return arena_alloc_align(a, size, 16);
+}
+
+void arena_merge(Arena *dst, Arena *src)
+{
+    if (!src->head)
+        return;
+
+    // src chunks go behind dst's so dst keeps filling its current chunk
+    if (dst->tail)
+        dst->tail->next = src->head;
+    else
+        dst->head = src->head;
+    dst->tail = src->tail;
+    dst->used += src->used;
+    arena_init(src);
+}
+
+void arena_free(Arena *a)
+{
+    ArenaChunk *c = a->head;
+    while (c)
+    {
+        ArenaChunk *next = c->next;
+        free(c);
+        c = next;
+    }
+    arena_init(a);
+}
+
+void strpool_init(StrPool *p, Arena *arena)
+{
+    p->arena = arena;
+    p->slots = NULL;
+    p->hashes = NULL;
+    p->cap = 0;
+    p->cnt = 0;
+}
+
+static uint32_t strpool_hash(const char *s, size_t len)
+{
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int strpool_grow(StrPool *p)
+{
+    size_t cap = p->cap ? p->cap * 2 : 1024;
+    const char **slots = (const char **)calloc(cap, sizeof(const char *));
+    uint32_t *hashes = (uint32_t *)malloc(cap * sizeof(uint32_t));
+    if (!slots || !hashes)
+    {
+        free(slots);
+        free(hashes);
+        return 0;
+    }
+
+    for (size_t i = 0; i < p->cap; i++)
+    {
+        if (!p->slots[i])
+            continue;
+        size_t j = p->hashes[i] & (cap - 1);
+        while (slots[j])
+            j = (j + 1) & (cap - 1);
+        slots[j] = p->slots[i];
+        hashes[j] = p->hashes[i];
+    }
+
+    free(p->slots);
+    free(p->hashes);
+    p->slots = slots;
+    p->hashes = hashes;
+    p->cap = cap;
+    return 1;
+}
+
+const char *strpool_intern(StrPool *p, const char *s, size_t len)
+{
+    // keep the table at most half full
+    if (p->cnt * 2 >= p->cap && !strpool_grow(p))
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+        return NULL;
+    }
+
+    uint32_t h = strpool_hash(s, len);
+    size_t i = h & (p->cap - 1);
+    while (p->slots[i])
+    {
+        if (p->hashes[i] == h && strncmp(p->slots[i], s, len) == 0 && p->slots[i][len] == '\0')
+        {
+            return p->slots[i];
+        }
+        i = (i + 1) & (p->cap - 1);
+    }
+
+    char *copy = (char *)arena_alloc_align(p->arena, len + 1, 1);
+    if (!copy)
+        return NULL;
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+
+    p->slots[i] = copy;
+    p->hashes[i] = h;
+    p->cnt++;
+    return copy;
+}
+
+void strpool_free(StrPool *p)
+{
+    free(p->slots);
+    free(p->hashes);
+    strpool_init(p, p->arena);
+}
+
+#endif /* ARENA_IMPLEMENTATION */
+#endif /* ARENA_H */
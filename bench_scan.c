@@ -0,0 +1,123 @@
+// Scan benchmark: --stat through io_uring against blocking fstatat() on
+// the pool and against the serial scan, on a synthetic tree of empty files.
+//
+//   bench_scan [files] [dir]
+//
+// files defaults to 1000000, spread 1000 to a directory under dir
+// (default /tmp/tranverse_bench_scan). The tree is made once and kept for
+// later runs. Caches are warm after the first pass; drop them between
+// runs (as root: echo 3 > /proc/sys/vm/drop_caches) for cold numbers.
+
+#define main tranverse_main
+#include "tranverse.c"
+#undef main
+
+#include <errno.h>
+#include <time.h>
+
+#define BENCH_FILES_PER_DIR 1000
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool make_dir(const char *path)
+{
+    if (mkdir(path, 0755) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "ERROR: FAILED TO CREATE %s (%s)\n", path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+// dir/dNNNN/fNNNN, skipped when a marker of a finished tree is there
+static bool make_tree(const char *dir, long files)
+{
+    char marker[512];
+    snprintf(marker, sizeof(marker), "%s/.done_%ld", dir, files);
+    if (access(marker, F_OK) == 0)
+        return true;
+
+    printf("creating %ld files under %s\n", files, dir);
+    if (!make_dir(dir))
+        return false;
+    char path[512];
+    for (long i = 0; i < files; i++)
+    {
+        long d = i / BENCH_FILES_PER_DIR;
+        if (i % BENCH_FILES_PER_DIR == 0)
+        {
+            snprintf(path, sizeof(path), "%s/d%05ld", dir, d);
+            if (!make_dir(path))
+                return false;
+        }
+        snprintf(path, sizeof(path), "%s/d%05ld/f%04ld", dir, d, i % BENCH_FILES_PER_DIR);
+        int fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            fprintf(stderr, "ERROR: FAILED TO CREATE %s (%s)\n", path, strerror(errno));
+            return false;
+        }
+        close(fd);
+    }
+
+    int fd = open(marker, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd >= 0)
+        close(fd);
+    return true;
+}
+
+static long count_nodes(Node *n)
+{
+    long cnt = 1;
+    for (Node *c = n->child; c; c = c->sibling)
+        cnt += count_nodes(c);
+    return cnt;
+}
+
+static void run(const char *label, const char *dir, ScanOptions opts, Pool *pool)
+{
+    NodeArena mem;
+    node_arena_init(&mem);
+    Node *root = new_node(&mem, "root", PARENT);
+
+    double t0 = now();
+    if (pool)
+        tranverse_parallel(&mem, dir, root, opts, pool);
+    else
+        tranverse(&mem, dir, root, opts);
+    double dt = now() - t0;
+
+    long nodes = count_nodes(root) - 1;
+    printf("%-28s %9ld entries %8.3f s %10.0f entries/s\n", label, nodes, dt, nodes / dt);
+    node_arena_free(&mem);
+}
+
+int main(int argc, char **argv)
+{
+    long files = argc > 1 ? atol(argv[1]) : 1000000;
+    const char *dir = argc > 2 ? argv[2] : "/tmp/tranverse_bench_scan";
+    if (files <= 0 || !make_tree(dir, files))
+        return 1;
+
+    ScanOptions uring = {false, true, true};
+    ScanOptions blocking = {false, true, false};
+    ScanOptions names = {false, false, false};
+    Pool *pool = pool_create(0);
+    if (!pool)
+        return 1;
+
+    // first pass only warms the caches
+    run("warm up", dir, names, pool);
+    run("serial, no stat", dir, names, NULL);
+    run("parallel, no stat", dir, names, pool);
+    run("serial, blocking stat", dir, blocking, NULL);
+    run("parallel, blocking stat", dir, blocking, pool);
+    run("parallel, io_uring stat", dir, uring, pool);
+    pool_destroy(pool);
+    return 0;
+}
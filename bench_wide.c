@@ -0,0 +1,86 @@
+// Wide directory benchmark: one parent with 1k, 100k and 1M children,
+// appended with add_child() and flattened with tree_store_build(). The
+// sibling-list walk add_child() used before the last_child link is timed
+// next to it while that stays quick enough to run.
+//
+//   bench_wide
+
+#define main tranverse_main
+#include "tranverse.c"
+#undef main
+
+#include <time.h>
+
+#define BENCH_WALK_MAX 100000 // quadratic, a million would take minutes
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// add_child() as it was, walking to the end of the siblings every time
+static void add_child_walk(Node *parent, Node *child)
+{
+    if (!parent->child)
+    {
+        parent->child = child;
+    }
+    else
+    {
+        Node *cur = parent->child;
+        while (cur->sibling)
+            cur = cur->sibling;
+        cur->sibling = child;
+    }
+    parent->last_child = child;
+    parent->child_cnt++;
+}
+
+static void run(int n, bool walk)
+{
+    NodeArena mem;
+    node_arena_init(&mem);
+    Node *root = new_node(&mem, "wide", PARENT);
+
+    char name[32];
+    double t0 = now();
+    for (int i = 0; i < n; i++)
+    {
+        snprintf(name, sizeof(name), "file_%07d.o", i);
+        Node *child = new_node(&mem, name, CHILD);
+        if (walk)
+            add_child_walk(root, child);
+        else
+            add_child(root, child);
+    }
+    double t_add = now() - t0;
+
+    if (walk)
+    {
+        printf("%8d entries  walk append %9.3f ms\n", n, t_add * 1e3);
+        node_arena_free(&mem);
+        return;
+    }
+
+    t0 = now();
+    TreeStore *t = tree_store_build(root, DEFAULT_MAX_LABEL);
+    double t_store = now() - t0;
+    printf("%8d entries  add_child   %9.3f ms (%6.1f ns each)  tree_store_build %9.3f ms\n",
+           n, t_add * 1e3, t_add * 1e9 / n, t_store * 1e3);
+    tree_store_free(t);
+    node_arena_free(&mem);
+}
+
+int main(void)
+{
+    static const int sizes[] = {1000, 100000, 1000000};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        run(sizes[i], false);
+        if (sizes[i] <= BENCH_WALK_MAX)
+            run(sizes[i], true);
+    }
+    return 0;
+}
@@ -2,8 +2,38 @@
 #define BITMAP_H
 unsigned char font8x8[128][8] = {
     [' '] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['_'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7E, 0x00},
+    ['!'] = {0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x10, 0x00},
+    ['"'] = {0x24, 0x24, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00},
+    ['#'] = {0x24, 0x24, 0x7E, 0x24, 0x7E, 0x24, 0x24, 0x00},
+    ['$'] = {0x10, 0x3C, 0x50, 0x38, 0x14, 0x78, 0x10, 0x00},
+    ['%'] = {0x62, 0x64, 0x08, 0x10, 0x20, 0x4C, 0x0C, 0x00},
+    ['&'] = {0x30, 0x48, 0x50, 0x20, 0x54, 0x48, 0x34, 0x00},
+    ['\''] = {0x10, 0x10, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00},
+    ['('] = {0x08, 0x10, 0x20, 0x20, 0x20, 0x10, 0x08, 0x00},
+    [')'] = {0x20, 0x10, 0x08, 0x08, 0x08, 0x10, 0x20, 0x00},
+    ['*'] = {0x00, 0x10, 0x54, 0x38, 0x54, 0x10, 0x00, 0x00},
+    ['+'] = {0x00, 0x10, 0x10, 0x7C, 0x10, 0x10, 0x00, 0x00},
+    [','] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x18},
+    ['-'] = {0x00, 0x00, 0x00, 0x7C, 0x00, 0x00, 0x00, 0x00},
     ['.'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18},
+    ['/'] = {0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x00, 0x00},
+    ['0'] = {0x3C, 0x42, 0x46, 0x4A, 0x52, 0x62, 0x3C, 0x00},
+    ['1'] = {0x08, 0x18, 0x28, 0x08, 0x08, 0x08, 0x3E, 0x00},
+    ['2'] = {0x3C, 0x42, 0x02, 0x04, 0x18, 0x20, 0x7E, 0x00},
+    ['3'] = {0x3C, 0x42, 0x02, 0x1C, 0x02, 0x42, 0x3C, 0x00},
+    ['4'] = {0x04, 0x0C, 0x14, 0x24, 0x44, 0x7E, 0x04, 0x00},
+    ['5'] = {0x7E, 0x40, 0x7C, 0x02, 0x02, 0x42, 0x3C, 0x00},
+    ['6'] = {0x1C, 0x20, 0x40, 0x7C, 0x42, 0x42, 0x3C, 0x00},
+    ['7'] = {0x7E, 0x02, 0x04, 0x08, 0x10, 0x10, 0x10, 0x00},
+    ['8'] = {0x3C, 0x42, 0x42, 0x3C, 0x42, 0x42, 0x3C, 0x00},
+    ['9'] = {0x3C, 0x42, 0x42, 0x3E, 0x02, 0x04, 0x38, 0x00},
+    [':'] = {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00, 0x00},
+    [';'] = {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x18, 0x00},
+    ['<'] = {0x08, 0x10, 0x20, 0x40, 0x20, 0x10, 0x08, 0x00},
+    ['='] = {0x00, 0x00, 0x7C, 0x00, 0x7C, 0x00, 0x00, 0x00},
+    ['>'] = {0x40, 0x20, 0x10, 0x08, 0x10, 0x20, 0x40, 0x00},
+    ['?'] = {0x3C, 0x42, 0x02, 0x0C, 0x10, 0x00, 0x10, 0x00},
+    ['@'] = {0x3C, 0x42, 0x5E, 0x56, 0x5C, 0x40, 0x3C, 0x00},
     ['A'] = {0x3C, 0x42, 0x42, 0x7E, 0x42, 0x42, 0x42, 0x00},
     ['B'] = {0x7C, 0x42, 0x42, 0x7C, 0x42, 0x42, 0x7C, 0x00},
     ['C'] = {0x3C, 0x42, 0x40, 0x40, 0x40, 0x42, 0x3C, 0x00},
@@ -30,16 +60,343 @@ unsigned char font8x8[128][8] = {
     ['X'] = {0x42, 0x24, 0x18, 0x18, 0x18, 0x24, 0x42, 0x00},
     ['Y'] = {0x42, 0x24, 0x18, 0x08, 0x08, 0x08, 0x08, 0x00},
     ['Z'] = {0x7E, 0x02, 0x04, 0x08, 0x10, 0x20, 0x7E, 0x00},
-    ['0'] = {0x3C, 0x42, 0x46, 0x4A, 0x52, 0x62, 0x3C, 0x00},
-    ['1'] = {0x08, 0x18, 0x28, 0x08, 0x08, 0x08, 0x3E, 0x00},
-    ['2'] = {0x3C, 0x42, 0x02, 0x04, 0x18, 0x20, 0x7E, 0x00},
-    ['3'] = {0x3C, 0x42, 0x02, 0x1C, 0x02, 0x42, 0x3C, 0x00},
-    ['4'] = {0x04, 0x0C, 0x14, 0x24, 0x44, 0x7E, 0x04, 0x00},
-    ['5'] = {0x7E, 0x40, 0x7C, 0x02, 0x02, 0x42, 0x3C, 0x00},
-    ['6'] = {0x1C, 0x20, 0x40, 0x7C, 0x42, 0x42, 0x3C, 0x00},
-    ['7'] = {0x7E, 0x02, 0x04, 0x08, 0x10, 0x10, 0x10, 0x00},
-    ['8'] = {0x3C, 0x42, 0x42, 0x3C, 0x42, 0x42, 0x3C, 0x00},
-    ['9'] = {0x3C, 0x42, 0x42, 0x3E, 0x02, 0x04, 0x38, 0x00},
+    ['['] = {0x38, 0x20, 0x20, 0x20, 0x20, 0x20, 0x38, 0x00},
+    ['\\'] = {0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x00, 0x00},
+    [']'] = {0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x38, 0x00},
+    ['^'] = {0x10, 0x28, 0x44, 0x00, 0x00, 0x00, 0x00, 0x00},
+    ['_'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7E, 0x00},
+    ['`'] = {0x20, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    ['a'] = {0x00, 0x00, 0x3C, 0x02, 0x3E, 0x42, 0x3E, 0x00},
+    ['b'] = {0x40, 0x40, 0x7C, 0x42, 0x42, 0x42, 0x7C, 0x00},
+    ['c'] = {0x00, 0x00, 0x3C, 0x40, 0x40, 0x40, 0x3C, 0x00},
+    ['d'] = {0x02, 0x02, 0x3E, 0x42, 0x42, 0x42, 0x3E, 0x00},
+    ['e'] = {0x00, 0x00, 0x3C, 0x42, 0x7E, 0x40, 0x3C, 0x00},
+    ['f'] = {0x1C, 0x20, 0x78, 0x20, 0x20, 0x20, 0x20, 0x00},
+    ['g'] = {0x00, 0x00, 0x3E, 0x42, 0x42, 0x3E, 0x02, 0x3C},
+    ['h'] = {0x40, 0x40, 0x7C, 0x42, 0x42, 0x42, 0x42, 0x00},
+    ['i'] = {0x10, 0x00, 0x30, 0x10, 0x10, 0x10, 0x38, 0x00},
+    ['j'] = {0x04, 0x00, 0x0C, 0x04, 0x04, 0x04, 0x44, 0x38},
+    ['k'] = {0x40, 0x40, 0x44, 0x48, 0x70, 0x48, 0x44, 0x00},
+    ['l'] = {0x30, 0x10, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00},
+    ['m'] = {0x00, 0x00, 0x68, 0x54, 0x54, 0x54, 0x44, 0x00},
+    ['n'] = {0x00, 0x00, 0x7C, 0x42, 0x42, 0x42, 0x42, 0x00},
+    ['o'] = {0x00, 0x00, 0x3C, 0x42, 0x42, 0x42, 0x3C, 0x00},
+    ['p'] = {0x00, 0x00, 0x7C, 0x42, 0x42, 0x7C, 0x40, 0x40},
+    ['q'] = {0x00, 0x00, 0x3E, 0x42, 0x42, 0x3E, 0x02, 0x02},
+    ['r'] = {0x00, 0x00, 0x5C, 0x60, 0x40, 0x40, 0x40, 0x00},
+    ['s'] = {0x00, 0x00, 0x3E, 0x40, 0x3C, 0x02, 0x7C, 0x00},
+    ['t'] = {0x20, 0x20, 0x78, 0x20, 0x20, 0x20, 0x18, 0x00},
+    ['u'] = {0x00, 0x00, 0x42, 0x42, 0x42, 0x42, 0x3E, 0x00},
+    ['v'] = {0x00, 0x00, 0x42, 0x42, 0x42, 0x24, 0x18, 0x00},
+    ['w'] = {0x00, 0x00, 0x44, 0x44, 0x54, 0x54, 0x28, 0x00},
+    ['x'] = {0x00, 0x00, 0x42, 0x24, 0x18, 0x24, 0x42, 0x00},
+    ['y'] = {0x00, 0x00, 0x42, 0x42, 0x42, 0x3E, 0x02, 0x3C},
+    ['z'] = {0x00, 0x00, 0x7E, 0x04, 0x18, 0x20, 0x7E, 0x00},
+    ['{'] = {0x0C, 0x10, 0x10, 0x20, 0x10, 0x10, 0x0C, 0x00},
+    ['|'] = {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00},
+    ['}'] = {0x30, 0x08, 0x08, 0x04, 0x08, 0x08, 0x30, 0x00},
+    ['~'] = {0x00, 0x00, 0x32, 0x4C, 0x00, 0x00, 0x00, 0x00},
+};
+
+// Marks drawn over a letter (two rows) or under it (the first row only)
+enum
+{
+    MARK_NONE,
+    MARK_GRAVE,
+    MARK_ACUTE,
+    MARK_CIRCUMFLEX,
+    MARK_TILDE,
+    MARK_MACRON,
+    MARK_BREVE,
+    MARK_DOT,
+    MARK_DIAERESIS,
+    MARK_RING,
+    MARK_DOUBLE_ACUTE,
+    MARK_CARON,
+    MARK_CEDILLA,
+    MARK_OGONEK,
+    MARK_COUNT
+};
+
+unsigned char font_marks[MARK_COUNT][2] = {
+    [MARK_GRAVE] = {0x20, 0x10},
+    [MARK_ACUTE] = {0x08, 0x10},
+    [MARK_CIRCUMFLEX] = {0x10, 0x28},
+    [MARK_TILDE] = {0x34, 0x48},
+    [MARK_MACRON] = {0x00, 0x3C},
+    [MARK_BREVE] = {0x24, 0x18},
+    [MARK_DOT] = {0x00, 0x10},
+    [MARK_DIAERESIS] = {0x00, 0x24},
+    [MARK_RING] = {0x38, 0x28},
+    [MARK_DOUBLE_ACUTE] = {0x14, 0x28},
+    [MARK_CARON] = {0x28, 0x10},
+    [MARK_CEDILLA] = {0x18, 0x00},
+    [MARK_OGONEK] = {0x0C, 0x00},
+};
+
+// Letters that are not an ASCII letter plus a mark
+enum
+{
+    FONT_SHARP_S = 0x80,
+    FONT_AE_SMALL,
+    FONT_AE,
+    FONT_O_STROKE_SMALL,
+    FONT_O_STROKE,
+    FONT_ETH_SMALL,
+    FONT_ETH,
+    FONT_THORN_SMALL,
+    FONT_THORN,
+    FONT_L_STROKE_SMALL,
+    FONT_L_STROKE,
+    FONT_OE_SMALL,
+    FONT_OE,
+    FONT_DOTLESS_I,
+    FONT_EXTRA_END
+};
+
+unsigned char font_extra[FONT_EXTRA_END - 0x80][8] = {
+    [FONT_SHARP_S - 0x80] = {0x38, 0x44, 0x48, 0x58, 0x44, 0x44, 0x58, 0x00}, // ß
+    [FONT_AE_SMALL - 0x80] = {0x00, 0x00, 0x6C, 0x12, 0x3E, 0x50, 0x2C, 0x00}, // æ
+    [FONT_AE - 0x80] = {0x3E, 0x50, 0x50, 0x7C, 0x50, 0x50, 0x5E, 0x00}, // Æ
+    [FONT_O_STROKE_SMALL - 0x80] = {0x00, 0x00, 0x3D, 0x46, 0x4A, 0x62, 0x7C, 0x00}, // ø
+    [FONT_O_STROKE - 0x80] = {0x3D, 0x46, 0x4A, 0x52, 0x62, 0x42, 0x7C, 0x00}, // Ø
+    [FONT_ETH_SMALL - 0x80] = {0x28, 0x10, 0x28, 0x02, 0x3E, 0x42, 0x3C, 0x00}, // ð
+    [FONT_ETH - 0x80] = {0x38, 0x24, 0x22, 0x7A, 0x22, 0x24, 0x38, 0x00}, // Ð
+    [FONT_THORN_SMALL - 0x80] = {0x40, 0x40, 0x7C, 0x42, 0x42, 0x7C, 0x40, 0x40}, // þ
+    [FONT_THORN - 0x80] = {0x40, 0x7C, 0x42, 0x42, 0x7C, 0x40, 0x40, 0x00}, // Þ
+    [FONT_L_STROKE_SMALL - 0x80] = {0x30, 0x10, 0x14, 0x18, 0x30, 0x10, 0x38, 0x00}, // ł
+    [FONT_L_STROKE - 0x80] = {0x20, 0x20, 0x28, 0x30, 0x60, 0x20, 0x3E, 0x00}, // Ł
+    [FONT_OE_SMALL - 0x80] = {0x00, 0x00, 0x2C, 0x52, 0x5E, 0x50, 0x2C, 0x00}, // œ
+    [FONT_OE - 0x80] = {0x3F, 0x48, 0x48, 0x4E, 0x48, 0x48, 0x3F, 0x00}, // Œ
+    [FONT_DOTLESS_I - 0x80] = {0x00, 0x00, 0x30, 0x10, 0x10, 0x10, 0x38, 0x00}, // ı
+};
+
+// U+00A0..U+017F as {base, mark}: base is an ASCII char or a FONT_ letter,
+// {0, 0} has no glyph
+#define FONT_LATIN_FIRST 0xA0
+#define FONT_LATIN_END 0x180
+unsigned char font_latin[FONT_LATIN_END - FONT_LATIN_FIRST][2] = {
+    [0xA0 - FONT_LATIN_FIRST] = {' ', MARK_NONE}, //  
+    [0xA1 - FONT_LATIN_FIRST] = {'!', MARK_NONE}, // ¡
+    [0xA2 - FONT_LATIN_FIRST] = {'c', MARK_NONE}, // ¢
+    [0xA3 - FONT_LATIN_FIRST] = {'L', MARK_NONE}, // £
+    [0xA4 - FONT_LATIN_FIRST] = {'*', MARK_NONE}, // ¤
+    [0xA5 - FONT_LATIN_FIRST] = {'Y', MARK_NONE}, // ¥
+    [0xA6 - FONT_LATIN_FIRST] = {'|', MARK_NONE}, // ¦
+    [0xA7 - FONT_LATIN_FIRST] = {'S', MARK_NONE}, // §
+    [0xA8 - FONT_LATIN_FIRST] = {'"', MARK_NONE}, // ¨
+    [0xA9 - FONT_LATIN_FIRST] = {'C', MARK_NONE}, // ©
+    [0xAA - FONT_LATIN_FIRST] = {'a', MARK_NONE}, // ª
+    [0xAB - FONT_LATIN_FIRST] = {'<', MARK_NONE}, // «
+    [0xAC - FONT_LATIN_FIRST] = {'-', MARK_NONE}, // ¬
+    [0xAD - FONT_LATIN_FIRST] = {'-', MARK_NONE}, // ­
+    [0xAE - FONT_LATIN_FIRST] = {'R', MARK_NONE}, // ®
+    [0xAF - FONT_LATIN_FIRST] = {'-', MARK_NONE}, // ¯
+    [0xB0 - FONT_LATIN_FIRST] = {'o', MARK_NONE}, // °
+    [0xB1 - FONT_LATIN_FIRST] = {'+', MARK_NONE}, // ±
+    [0xB2 - FONT_LATIN_FIRST] = {'2', MARK_NONE}, // ²
+    [0xB3 - FONT_LATIN_FIRST] = {'3', MARK_NONE}, // ³
+    [0xB4 - FONT_LATIN_FIRST] = {'\'', MARK_NONE}, // ´
+    [0xB5 - FONT_LATIN_FIRST] = {'u', MARK_NONE}, // µ
+    [0xB6 - FONT_LATIN_FIRST] = {'P', MARK_NONE}, // ¶
+    [0xB7 - FONT_LATIN_FIRST] = {'.', MARK_NONE}, // ·
+    [0xB8 - FONT_LATIN_FIRST] = {',', MARK_NONE}, // ¸
+    [0xB9 - FONT_LATIN_FIRST] = {'1', MARK_NONE}, // ¹
+    [0xBA - FONT_LATIN_FIRST] = {'o', MARK_NONE}, // º
+    [0xBB - FONT_LATIN_FIRST] = {'>', MARK_NONE}, // »
+    [0xBF - FONT_LATIN_FIRST] = {'?', MARK_NONE}, // ¿
+    [0xC0 - FONT_LATIN_FIRST] = {'A', MARK_GRAVE}, // À
+    [0xC1 - FONT_LATIN_FIRST] = {'A', MARK_ACUTE}, // Á
+    [0xC2 - FONT_LATIN_FIRST] = {'A', MARK_CIRCUMFLEX}, // Â
+    [0xC3 - FONT_LATIN_FIRST] = {'A', MARK_TILDE}, // Ã
+    [0xC4 - FONT_LATIN_FIRST] = {'A', MARK_DIAERESIS}, // Ä
+    [0xC5 - FONT_LATIN_FIRST] = {'A', MARK_RING}, // Å
+    [0xC6 - FONT_LATIN_FIRST] = {FONT_AE, MARK_NONE}, // Æ
+    [0xC7 - FONT_LATIN_FIRST] = {'C', MARK_CEDILLA}, // Ç
+    [0xC8 - FONT_LATIN_FIRST] = {'E', MARK_GRAVE}, // È
+    [0xC9 - FONT_LATIN_FIRST] = {'E', MARK_ACUTE}, // É
+    [0xCA - FONT_LATIN_FIRST] = {'E', MARK_CIRCUMFLEX}, // Ê
+    [0xCB - FONT_LATIN_FIRST] = {'E', MARK_DIAERESIS}, // Ë
+    [0xCC - FONT_LATIN_FIRST] = {'I', MARK_GRAVE}, // Ì
+    [0xCD - FONT_LATIN_FIRST] = {'I', MARK_ACUTE}, // Í
+    [0xCE - FONT_LATIN_FIRST] = {'I', MARK_CIRCUMFLEX}, // Î
+    [0xCF - FONT_LATIN_FIRST] = {'I', MARK_DIAERESIS}, // Ï
+    [0xD0 - FONT_LATIN_FIRST] = {FONT_ETH, MARK_NONE}, // Ð
+    [0xD1 - FONT_LATIN_FIRST] = {'N', MARK_TILDE}, // Ñ
+    [0xD2 - FONT_LATIN_FIRST] = {'O', MARK_GRAVE}, // Ò
+    [0xD3 - FONT_LATIN_FIRST] = {'O', MARK_ACUTE}, // Ó
+    [0xD4 - FONT_LATIN_FIRST] = {'O', MARK_CIRCUMFLEX}, // Ô
+    [0xD5 - FONT_LATIN_FIRST] = {'O', MARK_TILDE}, // Õ
+    [0xD6 - FONT_LATIN_FIRST] = {'O', MARK_DIAERESIS}, // Ö
+    [0xD7 - FONT_LATIN_FIRST] = {'x', MARK_NONE}, // ×
+    [0xD8 - FONT_LATIN_FIRST] = {FONT_O_STROKE, MARK_NONE}, // Ø
+    [0xD9 - FONT_LATIN_FIRST] = {'U', MARK_GRAVE}, // Ù
+    [0xDA - FONT_LATIN_FIRST] = {'U', MARK_ACUTE}, // Ú
+    [0xDB - FONT_LATIN_FIRST] = {'U', MARK_CIRCUMFLEX}, // Û
+    [0xDC - FONT_LATIN_FIRST] = {'U', MARK_DIAERESIS}, // Ü
+    [0xDD - FONT_LATIN_FIRST] = {'Y', MARK_ACUTE}, // Ý
+    [0xDE - FONT_LATIN_FIRST] = {FONT_THORN, MARK_NONE}, // Þ
+    [0xDF - FONT_LATIN_FIRST] = {FONT_SHARP_S, MARK_NONE}, // ß
+    [0xE0 - FONT_LATIN_FIRST] = {'a', MARK_GRAVE}, // à
+    [0xE1 - FONT_LATIN_FIRST] = {'a', MARK_ACUTE}, // á
+    [0xE2 - FONT_LATIN_FIRST] = {'a', MARK_CIRCUMFLEX}, // â
+    [0xE3 - FONT_LATIN_FIRST] = {'a', MARK_TILDE}, // ã
+    [0xE4 - FONT_LATIN_FIRST] = {'a', MARK_DIAERESIS}, // ä
+    [0xE5 - FONT_LATIN_FIRST] = {'a', MARK_RING}, // å
+    [0xE6 - FONT_LATIN_FIRST] = {FONT_AE_SMALL, MARK_NONE}, // æ
+    [0xE7 - FONT_LATIN_FIRST] = {'c', MARK_CEDILLA}, // ç
+    [0xE8 - FONT_LATIN_FIRST] = {'e', MARK_GRAVE}, // è
+    [0xE9 - FONT_LATIN_FIRST] = {'e', MARK_ACUTE}, // é
+    [0xEA - FONT_LATIN_FIRST] = {'e', MARK_CIRCUMFLEX}, // ê
+    [0xEB - FONT_LATIN_FIRST] = {'e', MARK_DIAERESIS}, // ë
+    [0xEC - FONT_LATIN_FIRST] = {'i', MARK_GRAVE}, // ì
+    [0xED - FONT_LATIN_FIRST] = {'i', MARK_ACUTE}, // í
+    [0xEE - FONT_LATIN_FIRST] = {'i', MARK_CIRCUMFLEX}, // î
+    [0xEF - FONT_LATIN_FIRST] = {'i', MARK_DIAERESIS}, // ï
+    [0xF0 - FONT_LATIN_FIRST] = {FONT_ETH_SMALL, MARK_NONE}, // ð
+    [0xF1 - FONT_LATIN_FIRST] = {'n', MARK_TILDE}, // ñ
+    [0xF2 - FONT_LATIN_FIRST] = {'o', MARK_GRAVE}, // ò
+    [0xF3 - FONT_LATIN_FIRST] = {'o', MARK_ACUTE}, // ó
+    [0xF4 - FONT_LATIN_FIRST] = {'o', MARK_CIRCUMFLEX}, // ô
+    [0xF5 - FONT_LATIN_FIRST] = {'o', MARK_TILDE}, // õ
+    [0xF6 - FONT_LATIN_FIRST] = {'o', MARK_DIAERESIS}, // ö
+    [0xF7 - FONT_LATIN_FIRST] = {'/', MARK_NONE}, // ÷
+    [0xF8 - FONT_LATIN_FIRST] = {FONT_O_STROKE_SMALL, MARK_NONE}, // ø
+    [0xF9 - FONT_LATIN_FIRST] = {'u', MARK_GRAVE}, // ù
+    [0xFA - FONT_LATIN_FIRST] = {'u', MARK_ACUTE}, // ú
+    [0xFB - FONT_LATIN_FIRST] = {'u', MARK_CIRCUMFLEX}, // û
+    [0xFC - FONT_LATIN_FIRST] = {'u', MARK_DIAERESIS}, // ü
+    [0xFD - FONT_LATIN_FIRST] = {'y', MARK_ACUTE}, // ý
+    [0xFE - FONT_LATIN_FIRST] = {FONT_THORN_SMALL, MARK_NONE}, // þ
+    [0xFF - FONT_LATIN_FIRST] = {'y', MARK_DIAERESIS}, // ÿ
+    [0x100 - FONT_LATIN_FIRST] = {'A', MARK_MACRON}, // Ā
+    [0x101 - FONT_LATIN_FIRST] = {'a', MARK_MACRON}, // ā
+    [0x102 - FONT_LATIN_FIRST] = {'A', MARK_BREVE}, // Ă
+    [0x103 - FONT_LATIN_FIRST] = {'a', MARK_BREVE}, // ă
+    [0x104 - FONT_LATIN_FIRST] = {'A', MARK_OGONEK}, // Ą
+    [0x105 - FONT_LATIN_FIRST] = {'a', MARK_OGONEK}, // ą
+    [0x106 - FONT_LATIN_FIRST] = {'C', MARK_ACUTE}, // Ć
+    [0x107 - FONT_LATIN_FIRST] = {'c', MARK_ACUTE}, // ć
+    [0x108 - FONT_LATIN_FIRST] = {'C', MARK_CIRCUMFLEX}, // Ĉ
+    [0x109 - FONT_LATIN_FIRST] = {'c', MARK_CIRCUMFLEX}, // ĉ
+    [0x10A - FONT_LATIN_FIRST] = {'C', MARK_DOT}, // Ċ
+    [0x10B - FONT_LATIN_FIRST] = {'c', MARK_DOT}, // ċ
+    [0x10C - FONT_LATIN_FIRST] = {'C', MARK_CARON}, // Č
+    [0x10D - FONT_LATIN_FIRST] = {'c', MARK_CARON}, // č
+    [0x10E - FONT_LATIN_FIRST] = {'D', MARK_CARON}, // Ď
+    [0x10F - FONT_LATIN_FIRST] = {'d', MARK_CARON}, // ď
+    [0x110 - FONT_LATIN_FIRST] = {FONT_ETH, MARK_NONE}, // Đ
+    [0x111 - FONT_LATIN_FIRST] = {'d', MARK_NONE}, // đ
+    [0x112 - FONT_LATIN_FIRST] = {'E', MARK_MACRON}, // Ē
+    [0x113 - FONT_LATIN_FIRST] = {'e', MARK_MACRON}, // ē
+    [0x114 - FONT_LATIN_FIRST] = {'E', MARK_BREVE}, // Ĕ
+    [0x115 - FONT_LATIN_FIRST] = {'e', MARK_BREVE}, // ĕ
+    [0x116 - FONT_LATIN_FIRST] = {'E', MARK_DOT}, // Ė
+    [0x117 - FONT_LATIN_FIRST] = {'e', MARK_DOT}, // ė
+    [0x118 - FONT_LATIN_FIRST] = {'E', MARK_OGONEK}, // Ę
+    [0x119 - FONT_LATIN_FIRST] = {'e', MARK_OGONEK}, // ę
+    [0x11A - FONT_LATIN_FIRST] = {'E', MARK_CARON}, // Ě
+    [0x11B - FONT_LATIN_FIRST] = {'e', MARK_CARON}, // ě
+    [0x11C - FONT_LATIN_FIRST] = {'G', MARK_CIRCUMFLEX}, // Ĝ
+    [0x11D - FONT_LATIN_FIRST] = {'g', MARK_CIRCUMFLEX}, // ĝ
+    [0x11E - FONT_LATIN_FIRST] = {'G', MARK_BREVE}, // Ğ
+    [0x11F - FONT_LATIN_FIRST] = {'g', MARK_BREVE}, // ğ
+    [0x120 - FONT_LATIN_FIRST] = {'G', MARK_DOT}, // Ġ
+    [0x121 - FONT_LATIN_FIRST] = {'g', MARK_DOT}, // ġ
+    [0x122 - FONT_LATIN_FIRST] = {'G', MARK_CEDILLA}, // Ģ
+    [0x123 - FONT_LATIN_FIRST] = {'g', MARK_CEDILLA}, // ģ
+    [0x124 - FONT_LATIN_FIRST] = {'H', MARK_CIRCUMFLEX}, // Ĥ
+    [0x125 - FONT_LATIN_FIRST] = {'h', MARK_CIRCUMFLEX}, // ĥ
+    [0x126 - FONT_LATIN_FIRST] = {'H', MARK_NONE}, // Ħ
+    [0x127 - FONT_LATIN_FIRST] = {'h', MARK_NONE}, // ħ
+    [0x128 - FONT_LATIN_FIRST] = {'I', MARK_TILDE}, // Ĩ
+    [0x129 - FONT_LATIN_FIRST] = {'i', MARK_TILDE}, // ĩ
+    [0x12A - FONT_LATIN_FIRST] = {'I', MARK_MACRON}, // Ī
+    [0x12B - FONT_LATIN_FIRST] = {'i', MARK_MACRON}, // ī
+    [0x12C - FONT_LATIN_FIRST] = {'I', MARK_BREVE}, // Ĭ
+    [0x12D - FONT_LATIN_FIRST] = {'i', MARK_BREVE}, // ĭ
+    [0x12E - FONT_LATIN_FIRST] = {'I', MARK_OGONEK}, // Į
+    [0x12F - FONT_LATIN_FIRST] = {'i', MARK_OGONEK}, // į
+    [0x130 - FONT_LATIN_FIRST] = {'I', MARK_DOT}, // İ
+    [0x131 - FONT_LATIN_FIRST] = {FONT_DOTLESS_I, MARK_NONE}, // ı
+    [0x132 - FONT_LATIN_FIRST] = {'I', MARK_NONE}, // Ĳ
+    [0x133 - FONT_LATIN_FIRST] = {'i', MARK_NONE}, // ĳ
+    [0x134 - FONT_LATIN_FIRST] = {'J', MARK_CIRCUMFLEX}, // Ĵ
+    [0x135 - FONT_LATIN_FIRST] = {'j', MARK_CIRCUMFLEX}, // ĵ
+    [0x136 - FONT_LATIN_FIRST] = {'K', MARK_CEDILLA}, // Ķ
+    [0x137 - FONT_LATIN_FIRST] = {'k', MARK_CEDILLA}, // ķ
+    [0x138 - FONT_LATIN_FIRST] = {'k', MARK_NONE}, // ĸ
+    [0x139 - FONT_LATIN_FIRST] = {'L', MARK_ACUTE}, // Ĺ
+    [0x13A - FONT_LATIN_FIRST] = {'l', MARK_ACUTE}, // ĺ
+    [0x13B - FONT_LATIN_FIRST] = {'L', MARK_CEDILLA}, // Ļ
+    [0x13C - FONT_LATIN_FIRST] = {'l', MARK_CEDILLA}, // ļ
+    [0x13D - FONT_LATIN_FIRST] = {'L', MARK_CARON}, // Ľ
+    [0x13E - FONT_LATIN_FIRST] = {'l', MARK_CARON}, // ľ
+    [0x13F - FONT_LATIN_FIRST] = {'L', MARK_NONE}, // Ŀ
+    [0x140 - FONT_LATIN_FIRST] = {'l', MARK_NONE}, // ŀ
+    [0x141 - FONT_LATIN_FIRST] = {FONT_L_STROKE, MARK_NONE}, // Ł
+    [0x142 - FONT_LATIN_FIRST] = {FONT_L_STROKE_SMALL, MARK_NONE}, // ł
+    [0x143 - FONT_LATIN_FIRST] = {'N', MARK_ACUTE}, // Ń
+    [0x144 - FONT_LATIN_FIRST] = {'n', MARK_ACUTE}, // ń
+    [0x145 - FONT_LATIN_FIRST] = {'N', MARK_CEDILLA}, // Ņ
+    [0x146 - FONT_LATIN_FIRST] = {'n', MARK_CEDILLA}, // ņ
+    [0x147 - FONT_LATIN_FIRST] = {'N', MARK_CARON}, // Ň
+    [0x148 - FONT_LATIN_FIRST] = {'n', MARK_CARON}, // ň
+    [0x149 - FONT_LATIN_FIRST] = {'n', MARK_NONE}, // ŉ
+    [0x14A - FONT_LATIN_FIRST] = {'N', MARK_NONE}, // Ŋ
+    [0x14B - FONT_LATIN_FIRST] = {'n', MARK_NONE}, // ŋ
+    [0x14C - FONT_LATIN_FIRST] = {'O', MARK_MACRON}, // Ō
+    [0x14D - FONT_LATIN_FIRST] = {'o', MARK_MACRON}, // ō
+    [0x14E - FONT_LATIN_FIRST] = {'O', MARK_BREVE}, // Ŏ
+    [0x14F - FONT_LATIN_FIRST] = {'o', MARK_BREVE}, // ŏ
+    [0x150 - FONT_LATIN_FIRST] = {'O', MARK_DOUBLE_ACUTE}, // Ő
+    [0x151 - FONT_LATIN_FIRST] = {'o', MARK_DOUBLE_ACUTE}, // ő
+    [0x152 - FONT_LATIN_FIRST] = {FONT_OE, MARK_NONE}, // Œ
+    [0x153 - FONT_LATIN_FIRST] = {FONT_OE_SMALL, MARK_NONE}, // œ
+    [0x154 - FONT_LATIN_FIRST] = {'R', MARK_ACUTE}, // Ŕ
+    [0x155 - FONT_LATIN_FIRST] = {'r', MARK_ACUTE}, // ŕ
+    [0x156 - FONT_LATIN_FIRST] = {'R', MARK_CEDILLA}, // Ŗ
+    [0x157 - FONT_LATIN_FIRST] = {'r', MARK_CEDILLA}, // ŗ
+    [0x158 - FONT_LATIN_FIRST] = {'R', MARK_CARON}, // Ř
+    [0x159 - FONT_LATIN_FIRST] = {'r', MARK_CARON}, // ř
+    [0x15A - FONT_LATIN_FIRST] = {'S', MARK_ACUTE}, // Ś
+    [0x15B - FONT_LATIN_FIRST] = {'s', MARK_ACUTE}, // ś
+    [0x15C - FONT_LATIN_FIRST] = {'S', MARK_CIRCUMFLEX}, // Ŝ
+    [0x15D - FONT_LATIN_FIRST] = {'s', MARK_CIRCUMFLEX}, // ŝ
+    [0x15E - FONT_LATIN_FIRST] = {'S', MARK_CEDILLA}, // Ş
+    [0x15F - FONT_LATIN_FIRST] = {'s', MARK_CEDILLA}, // ş
+    [0x160 - FONT_LATIN_FIRST] = {'S', MARK_CARON}, // Š
+    [0x161 - FONT_LATIN_FIRST] = {'s', MARK_CARON}, // š
+    [0x162 - FONT_LATIN_FIRST] = {'T', MARK_CEDILLA}, // Ţ
+    [0x163 - FONT_LATIN_FIRST] = {'t', MARK_CEDILLA}, // ţ
+    [0x164 - FONT_LATIN_FIRST] = {'T', MARK_CARON}, // Ť
+    [0x165 - FONT_LATIN_FIRST] = {'t', MARK_CARON}, // ť
+    [0x166 - FONT_LATIN_FIRST] = {'T', MARK_NONE}, // Ŧ
+    [0x167 - FONT_LATIN_FIRST] = {'t', MARK_NONE}, // ŧ
+    [0x168 - FONT_LATIN_FIRST] = {'U', MARK_TILDE}, // Ũ
+    [0x169 - FONT_LATIN_FIRST] = {'u', MARK_TILDE}, // ũ
+    [0x16A - FONT_LATIN_FIRST] = {'U', MARK_MACRON}, // Ū
+    [0x16B - FONT_LATIN_FIRST] = {'u', MARK_MACRON}, // ū
+    [0x16C - FONT_LATIN_FIRST] = {'U', MARK_BREVE}, // Ŭ
+    [0x16D - FONT_LATIN_FIRST] = {'u', MARK_BREVE}, // ŭ
+    [0x16E - FONT_LATIN_FIRST] = {'U', MARK_RING}, // Ů
+    [0x16F - FONT_LATIN_FIRST] = {'u', MARK_RING}, // ů
+    [0x170 - FONT_LATIN_FIRST] = {'U', MARK_DOUBLE_ACUTE}, // Ű
+    [0x171 - FONT_LATIN_FIRST] = {'u', MARK_DOUBLE_ACUTE}, // ű
+    [0x172 - FONT_LATIN_FIRST] = {'U', MARK_OGONEK}, // Ų
+    [0x173 - FONT_LATIN_FIRST] = {'u', MARK_OGONEK}, // ų
+    [0x174 - FONT_LATIN_FIRST] = {'W', MARK_CIRCUMFLEX}, // Ŵ
+    [0x175 - FONT_LATIN_FIRST] = {'w', MARK_CIRCUMFLEX}, // ŵ
+    [0x176 - FONT_LATIN_FIRST] = {'Y', MARK_CIRCUMFLEX}, // Ŷ
+    [0x177 - FONT_LATIN_FIRST] = {'y', MARK_CIRCUMFLEX}, // ŷ
+    [0x178 - FONT_LATIN_FIRST] = {'Y', MARK_DIAERESIS}, // Ÿ
+    [0x179 - FONT_LATIN_FIRST] = {'Z', MARK_ACUTE}, // Ź
+    [0x17A - FONT_LATIN_FIRST] = {'z', MARK_ACUTE}, // ź
+    [0x17B - FONT_LATIN_FIRST] = {'Z', MARK_DOT}, // Ż
+    [0x17C - FONT_LATIN_FIRST] = {'z', MARK_DOT}, // ż
+    [0x17D - FONT_LATIN_FIRST] = {'Z', MARK_CARON}, // Ž
+    [0x17E - FONT_LATIN_FIRST] = {'z', MARK_CARON}, // ž
+    [0x17F - FONT_LATIN_FIRST] = {'f', MARK_NONE}, // ſ
 };
 
 #endif // BITMAP_H
\ No newline at end of file
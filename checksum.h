@@ -0,0 +1,299 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+/* CRC-32 (PNG chunks) and Adler-32 (zlib trailer).
+ *
+ * On x86 with GCC or Clang the CRC folds 64 bytes at a time with PCLMULQDQ
+ * and Adler-32 sums 32 bytes at a time with SSSE3, picked once at runtime
+ * from CPUID; otherwise slice-by-8 tables and the plain loop are used.
+ * Both take and return the finished value, zlib style, so they chain.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// crc of the bytes so far (0 to start) updated with p[0..len)
+uint32_t crc32_update(uint32_t crc, const unsigned char *p, size_t len);
+
+// adler of the bytes so far (1 to start) updated with p[0..len)
+uint32_t adler32_update(uint32_t adler, const unsigned char *p, size_t len);
+
+// adler32 of A followed by B, from adler32(A), adler32(B) and len(B)
+uint32_t adler32_combine(uint32_t adler_a, uint32_t adler_b, size_t len_b);
+
+// the instruction set the checksums run with, for logs
+const char *checksum_isa(void);
+
+#ifdef CHECKSUM_IMPLEMENTATION
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CHECKSUM_X86
+#include <immintrin.h>
+#endif
+
+// the pool's workers may race to set the tables up, publish them last
+#ifdef __GNUC__
+#define CHECKSUM_LOAD(v) __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define CHECKSUM_STORE(v, x) __atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+#else
+#define CHECKSUM_LOAD(v) (v)
+#define CHECKSUM_STORE(v, x) ((v) = (x))
+#endif
+
+#define ADLER_MOD 65521
+// most bytes summed before s2 can overflow 32 bits
+#define ADLER_NMAX 5552
+
+static uint32_t crc_tables[8][256];
+static uint32_t (*crc_fold)(uint32_t crc, const unsigned char *p, size_t len);
+static uint32_t (*adler_blocks)(uint32_t adler, const unsigned char *p, size_t len);
+static const char *checksum_isa_name;
+
+// crc is the raw register here, not inverted
+static uint32_t crc32_slice8(uint32_t crc, const unsigned char *p, size_t len)
+{
+    while (len && ((uintptr_t)p & 7))
+    {
+        crc = crc_tables[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        len--;
+    }
+    while (len >= 8)
+    {
+        uint32_t lo = crc ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+        uint32_t hi = (uint32_t)p[4] | (uint32_t)p[5] << 8 | (uint32_t)p[6] << 16 | (uint32_t)p[7] << 24;
+        crc = crc_tables[7][lo & 0xFF] ^ crc_tables[6][(lo >> 8) & 0xFF] ^
+              crc_tables[5][(lo >> 16) & 0xFF] ^ crc_tables[4][lo >> 24] ^
+              crc_tables[3][hi & 0xFF] ^ crc_tables[2][(hi >> 8) & 0xFF] ^
+              crc_tables[1][(hi >> 16) & 0xFF] ^ crc_tables[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len--)
+        crc = crc_tables[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+static uint32_t adler32_scalar(uint32_t adler, const unsigned char *p, size_t len)
+{
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    while (len > 0)
+    {
+        size_t n = len < ADLER_NMAX ? len : ADLER_NMAX;
+        for (size_t k = 0; k < n; k++)
+        {
+            a += p[k];
+            b += a;
+        }
+        a %= ADLER_MOD;
+        b %= ADLER_MOD;
+        p += n;
+        len -= n;
+    }
+    return (b << 16) | a;
+}
+
+#ifdef CHECKSUM_X86
+// Folds 4 x 128 bits per step with carry-less multiplies, then reduces to
+// 32 bits with Barrett; the constants are x^k mod P for the reflected
+// polynomial. Takes len >= 64, a multiple of 16.
+__attribute__((target("pclmul,sse4.1"))) static uint32_t crc32_pclmul_blocks(uint32_t crc, const unsigned char *p, size_t len)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+    const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    __m128i x1 = _mm_loadu_si128((const __m128i *)(p + 0x00));
+    __m128i x2 = _mm_loadu_si128((const __m128i *)(p + 0x10));
+    __m128i x3 = _mm_loadu_si128((const __m128i *)(p + 0x20));
+    __m128i x4 = _mm_loadu_si128((const __m128i *)(p + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    p += 64;
+    len -= 64;
+
+    while (len >= 64)
+    {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(p + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(p + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(p + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(p + 0x30)));
+        p += 64;
+        len -= 64;
+    }
+
+    // four lanes into one
+    __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while (len >= 16)
+    {
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *)p)), x5);
+        p += 16;
+        len -= 16;
+    }
+
+    // 128 -> 64 bits
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc32_pclmul(uint32_t crc, const unsigned char *p, size_t len)
+{
+    if (len >= 64)
+    {
+        size_t n = len & ~(size_t)15;
+        crc = crc32_pclmul_blocks(crc, p, n);
+        p += n;
+        len -= n;
+    }
+    return crc32_slice8(crc, p, len);
+}
+
+// 32 bytes per step: s1 takes the byte sums, s2 the sums weighted 32..1
+// plus 32 times the s1 each step started with
+__attribute__((target("ssse3"))) static uint32_t adler32_ssse3(uint32_t adler, const unsigned char *p, size_t len)
+{
+    uint32_t s1 = adler & 0xFFFF, s2 = adler >> 16;
+    size_t blocks = len / 32;
+    len -= blocks * 32;
+
+    const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+    const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+
+    while (blocks)
+    {
+        size_t n = ADLER_NMAX / 32;
+        if (n > blocks)
+            n = blocks;
+        blocks -= n;
+
+        __m128i v_ps = _mm_set_epi32(0, 0, 0, (int)(s1 * n));
+        __m128i v_s2 = _mm_set_epi32(0, 0, 0, (int)s2);
+        __m128i v_s1 = zero;
+        do
+        {
+            __m128i b1 = _mm_loadu_si128((const __m128i *)p);
+            __m128i b2 = _mm_loadu_si128((const __m128i *)(p + 16));
+            v_ps = _mm_add_epi32(v_ps, v_s1);
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(b1, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(b1, tap1), ones));
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(b2, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(b2, tap2), ones));
+            p += 32;
+        } while (--n);
+        v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 += (uint32_t)_mm_cvtsi128_si32(v_s1);
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s2 = (uint32_t)_mm_cvtsi128_si32(v_s2);
+        s1 %= ADLER_MOD;
+        s2 %= ADLER_MOD;
+    }
+    return adler32_scalar((s2 << 16) | s1, p, len);
+}
+#endif /* CHECKSUM_X86 */
+
+static void checksum_init(void)
+{
+    if (CHECKSUM_LOAD(crc_fold))
+        return;
+
+    for (uint32_t n = 0; n < 256; n++)
+    {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc_tables[0][n] = c;
+    }
+    for (int t = 1; t < 8; t++)
+    {
+        for (int n = 0; n < 256; n++)
+            crc_tables[t][n] = crc_tables[0][crc_tables[t - 1][n] & 0xFF] ^ (crc_tables[t - 1][n] >> 8);
+    }
+
+    adler_blocks = adler32_scalar;
+    checksum_isa_name = "scalar";
+#ifdef CHECKSUM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        adler_blocks = adler32_ssse3;
+        checksum_isa_name = "ssse3";
+    }
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+    {
+        checksum_isa_name = adler_blocks == adler32_scalar ? "pclmul" : "pclmul+ssse3";
+        CHECKSUM_STORE(crc_fold, crc32_pclmul);
+        return;
+    }
+#endif
+    CHECKSUM_STORE(crc_fold, crc32_slice8);
+}
+
+const char *checksum_isa(void)
+{
+    checksum_init();
+    return checksum_isa_name;
+}
+
+uint32_t crc32_update(uint32_t crc, const unsigned char *p, size_t len)
+{
+    checksum_init();
+    return ~crc_fold(~crc, p, len);
+}
+
+uint32_t adler32_update(uint32_t adler, const unsigned char *p, size_t len)
+{
+    checksum_init();
+    return adler_blocks(adler, p, len);
+}
+
+uint32_t adler32_combine(uint32_t adler_a, uint32_t adler_b, size_t len_b)
+{
+    uint32_t rem = (uint32_t)(len_b % ADLER_MOD);
+    uint32_t a1 = adler_a & 0xFFFF, b1 = adler_a >> 16;
+    uint32_t a2 = adler_b & 0xFFFF, b2 = adler_b >> 16;
+
+    // a = a1 + a2 - 1, b = b1 + b2 + rem * (a1 - 1)
+    uint32_t a = (a1 + a2 + ADLER_MOD - 1) % ADLER_MOD;
+    uint32_t b = (uint32_t)(((uint64_t)rem * a1) % ADLER_MOD);
+    b = (b + b1 + b2 + ADLER_MOD - rem) % ADLER_MOD;
+    return (b << 16) | a;
+}
+
+#endif /* CHECKSUM_IMPLEMENTATION */
+#endif /* CHECKSUM_H */
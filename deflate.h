@@ -0,0 +1,333 @@
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+/* Incremental raw deflate (RFC 1951) encoder.
+ *
+ * LZ77 over a sliding 32K window with hash chains, fixed Huffman codes.
+ * Input is pushed with deflate_write() and compressed bytes come out through
+ * the callback in pieces of at most DEFLATE_OUT_SIZE. The zlib wrapper, if
+ * any, is the caller's job (see checksum.h for the Adler-32).
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DEFLATE_OUT_SIZE (1 << 16)
+#define DEFLATE_DEFAULT_LEVEL 8
+
+typedef void (*deflate_out_fn)(void *user, const unsigned char *data, size_t len);
+
+typedef struct Deflate Deflate;
+
+// level 1..9 trades speed for ratio, like zlib
+Deflate *deflate_create(int level, deflate_out_fn out, void *user);
+
+// forgets all input and output, output now goes to the callback with user
+void deflate_reset(Deflate *d, void *user);
+
+// preset history that matches may refer to; only before the first write
+void deflate_dictionary(Deflate *d, const unsigned char *data, size_t len);
+
+void deflate_write(Deflate *d, const unsigned char *data, size_t len);
+
+// final: ends the stream with the last block;
+// otherwise a sync flush, the output so far is byte aligned and decodable
+void deflate_flush(Deflate *d, bool final);
+
+void deflate_destroy(Deflate *d);
+
+#ifdef DEFLATE_IMPLEMENTATION
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFLATE_WSIZE 32768
+#define DEFLATE_WMASK (DEFLATE_WSIZE - 1)
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_LOOKAHEAD (DEFLATE_MAX_MATCH + DEFLATE_MIN_MATCH + 1)
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_HASH_SIZE (1 << DEFLATE_HASH_BITS)
+
+struct Deflate
+{
+    deflate_out_fn out;
+    void *user;
+    int max_chain;
+    bool in_block;
+
+    // the last 32K plus whatever is not encoded yet
+    unsigned char win[2 * DEFLATE_WSIZE];
+    int win_len;
+    int pos;
+    int head[DEFLATE_HASH_SIZE];
+    int chain[DEFLATE_WSIZE];
+
+    uint64_t bitbuf;
+    int bitcnt;
+    unsigned char buf[DEFLATE_OUT_SIZE];
+    size_t buf_len;
+};
+
+static void deflate_emit(Deflate *d)
+{
+    if (d->buf_len)
+    {
+        d->out(d->user, d->buf, d->buf_len);
+        d->buf_len = 0;
+    }
+}
+
+static void deflate_bits(Deflate *d, uint32_t bits, int n)
+{
+    d->bitbuf |= (uint64_t)bits << d->bitcnt;
+    d->bitcnt += n;
+    while (d->bitcnt >= 8)
+    {
+        d->buf[d->buf_len++] = (unsigned char)d->bitbuf;
+        if (d->buf_len == DEFLATE_OUT_SIZE)
+            deflate_emit(d);
+        d->bitbuf >>= 8;
+        d->bitcnt -= 8;
+    }
+}
+
+static void deflate_align(Deflate *d)
+{
+    if (d->bitcnt)
+        deflate_bits(d, 0, 8 - d->bitcnt);
+}
+
+static uint32_t deflate_bitrev(uint32_t code, int n)
+{
+    uint32_t r = 0;
+    while (n--)
+    {
+        r = (r << 1) | (code & 1);
+        code >>= 1;
+    }
+    return r;
+}
+
+// fixed Huffman code of a literal/length symbol
+static void deflate_sym(Deflate *d, int sym)
+{
+    if (sym <= 143)
+        deflate_bits(d, deflate_bitrev(0x30 + sym, 8), 8);
+    else if (sym <= 255)
+        deflate_bits(d, deflate_bitrev(0x190 + sym - 144, 9), 9);
+    else if (sym <= 279)
+        deflate_bits(d, deflate_bitrev(sym - 256, 7), 7);
+    else
+        deflate_bits(d, deflate_bitrev(0xC0 + sym - 280, 8), 8);
+}
+
+static void deflate_match(Deflate *d, int len, int dist)
+{
+    static const unsigned short lbase[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258, 259};
+    static const unsigned char lextra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const unsigned short dbase[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577, 32769};
+    static const unsigned char dextra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    int j = 0;
+    while (len >= lbase[j + 1])
+        j++;
+    deflate_sym(d, 257 + j);
+    if (lextra[j])
+        deflate_bits(d, len - lbase[j], lextra[j]);
+
+    j = 0;
+    while (dist >= dbase[j + 1])
+        j++;
+    deflate_bits(d, deflate_bitrev(j, 5), 5);
+    if (dextra[j])
+        deflate_bits(d, dist - dbase[j], dextra[j]);
+}
+
+static unsigned int deflate_hash(const unsigned char *p)
+{
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+    return (v * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+static void deflate_insert(Deflate *d, int p)
+{
+    unsigned int h = deflate_hash(d->win + p);
+    d->chain[p & DEFLATE_WMASK] = d->head[h];
+    d->head[h] = p;
+}
+
+static void deflate_begin_block(Deflate *d)
+{
+    if (!d->in_block)
+    {
+        deflate_bits(d, 0, 1); // BFINAL = 0
+        deflate_bits(d, 1, 2); // BTYPE = 1 -- fixed huffman
+        d->in_block = true;
+    }
+}
+
+// Encodes the window up to end; callers keep enough lookahead unless flushing
+static void deflate_compress(Deflate *d, int end)
+{
+    if (d->pos < end)
+        deflate_begin_block(d);
+
+    while (d->pos < end)
+    {
+        int avail = d->win_len - d->pos;
+        int best = 0, best_dist = 0;
+
+        if (avail >= DEFLATE_MIN_MATCH)
+        {
+            int limit = avail < DEFLATE_MAX_MATCH ? avail : DEFLATE_MAX_MATCH;
+            const unsigned char *cur = d->win + d->pos;
+            int cand = d->head[deflate_hash(cur)];
+            int chain = d->max_chain;
+            while (cand >= 0 && cand < d->pos && d->pos - cand < DEFLATE_WSIZE && chain--)
+            {
+                const unsigned char *m = d->win + cand;
+                if (m[best] == cur[best])
+                {
+                    int len = 0;
+                    while (len < limit && m[len] == cur[len])
+                        len++;
+                    if (len > best)
+                    {
+                        best = len;
+                        best_dist = d->pos - cand;
+                        if (len == limit)
+                            break;
+                    }
+                }
+                int next = d->chain[cand & DEFLATE_WMASK];
+                if (next >= cand)
+                    break;
+                cand = next;
+            }
+        }
+
+        if (best >= DEFLATE_MIN_MATCH)
+        {
+            deflate_match(d, best, best_dist);
+            for (int k = 0; k < best; k++)
+            {
+                if (d->win_len - (d->pos + k) >= DEFLATE_MIN_MATCH)
+                    deflate_insert(d, d->pos + k);
+            }
+            d->pos += best;
+        }
+        else
+        {
+            if (avail >= DEFLATE_MIN_MATCH)
+                deflate_insert(d, d->pos);
+            deflate_sym(d, d->win[d->pos]);
+            d->pos++;
+        }
+    }
+}
+
+static void deflate_slide(Deflate *d)
+{
+    memmove(d->win, d->win + DEFLATE_WSIZE, DEFLATE_WSIZE);
+    d->win_len -= DEFLATE_WSIZE;
+    d->pos -= DEFLATE_WSIZE;
+    for (int i = 0; i < DEFLATE_HASH_SIZE; i++)
+        d->head[i] = d->head[i] >= DEFLATE_WSIZE ? d->head[i] - DEFLATE_WSIZE : -1;
+    for (int i = 0; i < DEFLATE_WSIZE; i++)
+        d->chain[i] = d->chain[i] >= DEFLATE_WSIZE ? d->chain[i] - DEFLATE_WSIZE : -1;
+}
+
+Deflate *deflate_create(int level, deflate_out_fn out, void *user)
+{
+    Deflate *d = (Deflate *)malloc(sizeof(Deflate));
+    if (!d)
+        return NULL;
+    if (level < 1)
+        level = 1;
+    if (level > 9)
+        level = 9;
+    d->out = out;
+    d->max_chain = level * 4;
+    deflate_reset(d, user);
+    return d;
+}
+
+void deflate_reset(Deflate *d, void *user)
+{
+    d->user = user;
+    d->in_block = false;
+    d->win_len = 0;
+    d->pos = 0;
+    for (int i = 0; i < DEFLATE_HASH_SIZE; i++)
+        d->head[i] = -1;
+    d->bitbuf = 0;
+    d->bitcnt = 0;
+    d->buf_len = 0;
+}
+
+void deflate_dictionary(Deflate *d, const unsigned char *data, size_t len)
+{
+    if (len > DEFLATE_WSIZE)
+    {
+        data += len - DEFLATE_WSIZE;
+        len = DEFLATE_WSIZE;
+    }
+    memcpy(d->win, data, len);
+    d->win_len = (int)len;
+    for (int p = 0; p + DEFLATE_MIN_MATCH <= d->win_len; p++)
+        deflate_insert(d, p);
+    d->pos = d->win_len;
+}
+
+void deflate_write(Deflate *d, const unsigned char *data, size_t len)
+{
+    while (len > 0)
+    {
+        if (d->win_len == (int)sizeof(d->win))
+            deflate_slide(d);
+        size_t n = sizeof(d->win) - d->win_len;
+        if (n > len)
+            n = len;
+        memcpy(d->win + d->win_len, data, n);
+        d->win_len += (int)n;
+        data += n;
+        len -= n;
+
+        deflate_compress(d, d->win_len - DEFLATE_LOOKAHEAD);
+    }
+}
+
+void deflate_flush(Deflate *d, bool final)
+{
+    deflate_compress(d, d->win_len);
+    if (d->in_block)
+    {
+        deflate_sym(d, 256); // end of block
+        d->in_block = false;
+    }
+    if (final)
+    {
+        deflate_bits(d, 1, 1); // BFINAL = 1, an empty fixed block
+        deflate_bits(d, 1, 2);
+        deflate_sym(d, 256);
+        deflate_align(d);
+    }
+    else
+    {
+        // empty stored block, same as zlib's Z_SYNC_FLUSH
+        deflate_bits(d, 0, 3);
+        deflate_align(d);
+        deflate_bits(d, 0x0000, 16);
+        deflate_bits(d, 0xFFFF, 16);
+    }
+    deflate_emit(d);
+}
+
+void deflate_destroy(Deflate *d)
+{
+    free(d);
+}
+
+#endif /* DEFLATE_IMPLEMENTATION */
+#endif /* DEFLATE_H */
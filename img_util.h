@@ -1,33 +1,89 @@
 #ifndef IMG_UTIL_H
 #define IMG_UTIL_H
 
+#include <stddef.h>
+
+/* Colours of an indexed canvas, 0xRRGGBB like colors.h */
+typedef struct
+{
+    unsigned int colors[256];
+    int cnt;
+} Palette;
+
+/* Framebuffer, 3 bytes per pixel (RGB) or 1 (index into palette).
+ * Covers the w x h rectangle at (x0, y0) of the picture, so a tile or band
+ * of a bigger image is drawn with the same coordinates as the full one.
+ * stride is the distance between rows in bytes. */
+typedef struct
+{
+    unsigned char *img;
+    int w;
+    int h;
+    int x0;
+    int y0;
+    size_t stride;
+    int channels;
+    const Palette *palette; // when channels == 1
+} Canvas;
+
+// index of color, added when new; -1 once all 256 are taken
+int palette_add(Palette *p, unsigned int color);
+
+// index of color, 0 when it is not in the palette
+int palette_find(const Palette *p, unsigned int color);
+
+// smallest PNG bit depth (1, 2, 4 or 8) that holds every index
+int palette_bit_depth(const Palette *p);
+
 void set_pixel(
-    unsigned char *img, int w, int x, int y,
+    Canvas *c, int x, int y,
     unsigned int color);
 
 void fill_rect(
-    unsigned char *img, int w,
+    Canvas *c,
     int x, int y, int rw, int rh,
     unsigned int color);
 
 void draw_line(
-    unsigned char *img, int w,
+    Canvas *c,
     int x0, int y0, int x1, int y1);
 
 void draw_arrow(
-    unsigned char *img, int w,
+    Canvas *c,
     int x0, int y0, int x1, int y1);
 
+// cp is a unicode codepoint, ones the font lacks are drawn as a box
 void draw_char_scale(
-    unsigned char *img, int w,
-    int x, int y, char c, int scale);
+    Canvas *c,
+    int x, int y, unsigned int cp, int scale);
 
+// s is UTF-8, one glyph per codepoint
 void draw_text_scale(
-    unsigned char *img, int w,
+    Canvas *c,
     int x, int y, const char *s, int scale);
 
+// same, only the first len bytes of s, cut on a codepoint
+void draw_text_len(
+    Canvas *c,
+    int x, int y, const char *s, size_t len, int scale);
+
+// builds the glyph cache text is drawn from; the first text drawn does it
+// too, but not safely on several threads at once, so call this before
+void text_init(void);
+
+// number of glyphs draw_text_scale() draws for s
+int text_glyph_count(const char *s);
+
+// bytes taken by the first cnt glyphs of s
+size_t text_glyph_prefix(const char *s, int cnt);
+
 #ifdef IMG_UTIL_IMPLEMENTATION
 #include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__) || defined(_M_X64)
+#define IMG_UTIL_SSE2
+#include <emmintrin.h>
+#endif
 #include "bitmap.h"
 #include "colors.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -35,30 +91,141 @@ void draw_text_scale(
 
 #define BITMAP_SIZE 8
 
+int palette_add(Palette *p, unsigned int color)
+{
+    for (int i = 0; i < p->cnt; i++)
+    {
+        if (p->colors[i] == color)
+            return i;
+    }
+    if (p->cnt == 256)
+        return -1;
+    p->colors[p->cnt] = color;
+    return p->cnt++;
+}
+
+int palette_find(const Palette *p, unsigned int color)
+{
+    for (int i = 0; i < p->cnt; i++)
+    {
+        if (p->colors[i] == color)
+            return i;
+    }
+    return 0;
+}
+
+int palette_bit_depth(const Palette *p)
+{
+    if (p->cnt <= 2)
+        return 1;
+    if (p->cnt <= 4)
+        return 2;
+    if (p->cnt <= 16)
+        return 4;
+    return 8;
+}
+
 void set_pixel(
-    unsigned char *img, int w, int x, int y,
+    Canvas *c, int x, int y,
     unsigned int color)
 {
-    if (x < 0 || y < 0 || x >= w)
+    x -= c->x0;
+    y -= c->y0;
+    if (x < 0 || y < 0 || x >= c->w || y >= c->h)
+        return;
+    if (c->channels == 1)
+    {
+        c->img[(size_t)y * c->stride + x] = (unsigned char)palette_find(c->palette, color);
+        return;
+    }
+    size_t idx = (size_t)y * c->stride + (size_t)x * 3;
+    c->img[idx] = (color >> 16) & 0xFF;
+    c->img[idx + 1] =  (color >> 8)  & 0xFF;
+    c->img[idx + 2] = color        & 0xFF;
+}
+
+// n RGB pixels of one colour from row on
+static void fill_span_rgb(unsigned char *row, int n, unsigned int color)
+{
+    unsigned char r = (color >> 16) & 0xFF, g = (color >> 8) & 0xFF, b = color & 0xFF;
+    if (r == g && g == b)
+    {
+        memset(row, r, (size_t)n * 3);
+        return;
+    }
+
+#ifdef IMG_UTIL_SSE2
+    // 16 pixels are exactly three registers of the repeating pattern
+    if (n >= 16)
+    {
+        unsigned char pat[48];
+        for (int i = 0; i < 48; i += 3)
+        {
+            pat[i] = r;
+            pat[i + 1] = g;
+            pat[i + 2] = b;
+        }
+        __m128i v0 = _mm_loadu_si128((const __m128i *)pat);
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(pat + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i *)(pat + 32));
+        for (; n >= 16; n -= 16, row += 48)
+        {
+            _mm_storeu_si128((__m128i *)row, v0);
+            _mm_storeu_si128((__m128i *)(row + 16), v1);
+            _mm_storeu_si128((__m128i *)(row + 32), v2);
+        }
+    }
+#endif
+    for (; n > 0; n--, row += 3)
+    {
+        row[0] = r;
+        row[1] = g;
+        row[2] = b;
+    }
+}
+
+// fill_rect() with idx, the palette index of color on an indexed canvas,
+// looked up by the caller
+static void fill_rect_ink(
+    Canvas *c,
+    int x, int y, int rw, int rh,
+    unsigned int color, int idx)
+{
+    // clip once, then fill whole rows
+    int x0 = x - c->x0, y0 = y - c->y0;
+    int x1 = x0 + rw, y1 = y0 + rh;
+    if (x0 < 0)
+        x0 = 0;
+    if (y0 < 0)
+        y0 = 0;
+    if (x1 > c->w)
+        x1 = c->w;
+    if (y1 > c->h)
+        y1 = c->h;
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    unsigned char *row = c->img + (size_t)y0 * c->stride + (size_t)x0 * c->channels;
+    if (c->channels == 1)
+    {
+        for (int j = y0; j < y1; j++, row += c->stride)
+            memset(row, idx, (size_t)(x1 - x0));
         return;
-    int idx = (y * w + x) * 3;
-    img[idx] = (color >> 16) & 0xFF;
-    img[idx + 1] =  (color >> 8)  & 0xFF;
-    img[idx + 2] = color        & 0xFF;
+    }
+    for (int j = y0; j < y1; j++, row += c->stride)
+        fill_span_rgb(row, x1 - x0, color);
 }
 
 void fill_rect(
-    unsigned char *img, int w,
+    Canvas *c,
     int x, int y, int rw, int rh,
     unsigned int color)
 {
-    for (int j = 0; j < rh; j++)
-        for (int i = 0; i < rw; i++)
-            set_pixel(img, w, x + i, y + j, color);
+    fill_rect_ink(c, x, y, rw, rh, color, c->channels == 1 ? palette_find(c->palette, color) : 0);
 }
 
 void draw_line(
-    unsigned char *img, int w,
+    Canvas *c,
     int x0, int y0, int x1, int y1)
 {
     int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
@@ -67,7 +234,7 @@ void draw_line(
 
     while (1)
     {
-        set_pixel(img, w, x0, y0, COLOR_BLACK);
+        set_pixel(c, x0, y0, COLOR_BLACK);
         if (x0 == x1 && y0 == y1)
             break;
         int e2 = 2 * err;
@@ -85,49 +252,234 @@ void draw_line(
 }
 
 void draw_arrow(
-    unsigned char *img, int w,
+    Canvas *c,
     int x0, int y0, int x1, int y1)
 {
-    draw_line(img, w, x0, y0, x1, y1);
-    draw_line(img, w, x1, y1, x1 - 5, y1 - 5);
-    draw_line(img, w, x1, y1, x1 + 5, y1 - 5);
+    draw_line(c, x0, y0, x1, y1);
+    draw_line(c, x1, y1, x1 - 5, y1 - 5);
+    draw_line(c, x1, y1, x1 + 5, y1 - 5);
 }
 
-void draw_char_scale(unsigned char *img, int w,
-                     int x, int y, char c, int scale)
+// Glyph ids: codepoints below FONT_LATIN_END are their own id, anything
+// else is GLYPH_UNKNOWN, so finding a glyph is one compare.
+#define GLYPH_UNKNOWN FONT_LATIN_END
+#define GLYPH_COUNT (GLYPH_UNKNOWN + 1)
+
+static const unsigned char glyph_box[BITMAP_SIZE] = {0x7E, 0x42, 0x42, 0x42, 0x42, 0x42, 0x7E, 0x00};
+
+// Bitmap of a glyph id, composing the Latin blocks from font_latin
+static void glyph_bits(unsigned int id, unsigned char out[BITMAP_SIZE])
 {
-    for (int row = 0; row < 8; row++)
+    if (id >= 0x20 && id < 0x7F)
+    {
+        memcpy(out, font8x8[id], BITMAP_SIZE);
+        return;
+    }
+    if (id < FONT_LATIN_FIRST || id >= FONT_LATIN_END || !font_latin[id - FONT_LATIN_FIRST][0])
+    {
+        memcpy(out, glyph_box, BITMAP_SIZE);
+        return;
+    }
+
+    unsigned char base = font_latin[id - FONT_LATIN_FIRST][0];
+    unsigned char mark = font_latin[id - FONT_LATIN_FIRST][1];
+    const unsigned char *b = base < 0x80 ? font8x8[base] : font_extra[base - 0x80];
+    memcpy(out, b, BITMAP_SIZE);
+    if (mark == MARK_NONE)
+        return;
+
+    if (mark == MARK_CEDILLA || mark == MARK_OGONEK)
+    {
+        out[BITMAP_SIZE - 1] |= font_marks[mark][0];
+    }
+    else if (base >= 'A' && base <= 'Z')
+    {
+        // capitals fill the cell, drop their third row to make room
+        out[0] = font_marks[mark][0];
+        out[1] = font_marks[mark][1];
+        out[2] = b[0];
+        out[3] = b[1];
+        memcpy(out + 4, b + 3, 4);
+    }
+    else
     {
-        unsigned char bits = font8x8[(unsigned char)c][row];
+        // lowercase has two free rows on top, bar the dots of i and j
+        if (base == 'i' || base == 'j')
+            out[0] = out[1] = 0;
+        out[0] |= font_marks[mark][0];
+        out[1] |= font_marks[mark][1];
+    }
+}
+
+// Runs of set pixels in each row of each glyph, so text is drawn as
+// spans instead of bit by bit. Built from the font by text_init().
+typedef struct
+{
+    unsigned char cnt; // an 8 pixel row has at most 4 runs
+    unsigned char start[4];
+    unsigned char len[4];
+} GlyphRow;
+
+static GlyphRow glyph_rows[GLYPH_COUNT][BITMAP_SIZE];
+static int glyph_rows_ready;
 
-        for (int col = 0; col < 8; col++)
+void text_init(void)
+{
+#ifdef __GNUC__
+    if (__atomic_load_n(&glyph_rows_ready, __ATOMIC_ACQUIRE))
+        return;
+#else
+    if (glyph_rows_ready)
+        return;
+#endif
+    for (unsigned int id = 0; id < GLYPH_COUNT; id++)
+    {
+        unsigned char glyph[BITMAP_SIZE];
+        glyph_bits(id, glyph);
+        for (int row = 0; row < BITMAP_SIZE; row++)
         {
-            if ((bits << 1) & (1 << (7 - col)))
+            unsigned char bits = glyph[row];
+            GlyphRow *g = &glyph_rows[id][row];
+            g->cnt = 0;
+            for (int col = 0; col < BITMAP_SIZE;)
             {
-                for (int dy = 0; dy < scale; dy++)
+                // same test the font was always drawn with
+                if (!((bits << 1) & (1 << (7 - col))))
                 {
-                    for (int dx = 0; dx < scale; dx++)
-                    {
-                        set_pixel(img, w,
-                                  x + col * scale + dx,
-                                  y + row * scale + dy,
-                                  COLOR_BLACK);
-                    }
+                    col++;
+                    continue;
                 }
+                int from = col;
+                while (col < BITMAP_SIZE && ((bits << 1) & (1 << (7 - col))))
+                    col++;
+                g->start[g->cnt] = (unsigned char)from;
+                g->len[g->cnt] = (unsigned char)(col - from);
+                g->cnt++;
             }
         }
     }
+#ifdef __GNUC__
+    __atomic_store_n(&glyph_rows_ready, 1, __ATOMIC_RELEASE);
+#else
+    glyph_rows_ready = 1;
+#endif
 }
 
-void draw_text_scale(unsigned char *img, int w,
-                     int x, int y, const char *s, int scale)
+// Decodes the codepoint at *s and moves past it; a malformed byte is
+// skipped on its own as U+FFFD
+static unsigned int utf8_next(const char **s)
 {
+    const unsigned char *p = (const unsigned char *)*s;
+    unsigned int cp = p[0];
+    if (cp < 0x80)
+    {
+        *s += 1;
+        return cp;
+    }
+
+    int n = cp >= 0xC2 && cp < 0xE0 ? 1 : cp >= 0xE0 && cp < 0xF0 ? 2 : cp >= 0xF0 && cp < 0xF5 ? 3 : 0;
+    if (!n)
+    {
+        *s += 1;
+        return 0xFFFD;
+    }
+    cp &= 0x3F >> n;
+    for (int k = 1; k <= n; k++)
+    {
+        // also stops at the terminating NUL
+        if ((p[k] & 0xC0) != 0x80)
+        {
+            *s += 1;
+            return 0xFFFD;
+        }
+        cp = (cp << 6) | (p[k] & 0x3F);
+    }
+    *s += n + 1;
+    return cp;
+}
+
+int text_glyph_count(const char *s)
+{
+    int cnt = 0;
     while (*s)
     {
-        draw_char_scale(img, w, x, y, *s++, scale);
-        x += (BITMAP_SIZE * scale);
+        utf8_next(&s);
+        cnt++;
+    }
+    return cnt;
+}
+
+size_t text_glyph_prefix(const char *s, int cnt)
+{
+    const char *p = s;
+    while (*p && cnt-- > 0)
+        utf8_next(&p);
+    return (size_t)(p - s);
+}
+
+// Palette index text is drawn with, looked up once per string
+static int text_ink(const Canvas *c)
+{
+    return c->channels == 1 ? palette_find(c->palette, COLOR_BLACK) : 0;
+}
+
+static void draw_glyph(Canvas *c,
+                       int x, int y, unsigned int cp, int scale, int ink)
+{
+    const GlyphRow *rows = glyph_rows[cp < GLYPH_UNKNOWN ? cp : GLYPH_UNKNOWN];
+    for (int row = 0; row < BITMAP_SIZE; row++)
+    {
+        for (int k = 0; k < rows[row].cnt; k++)
+        {
+            fill_rect_ink(c,
+                          x + rows[row].start[k] * scale,
+                          y + row * scale,
+                          rows[row].len[k] * scale, scale,
+                          COLOR_BLACK, ink);
+        }
+    }
+}
+
+void draw_char_scale(Canvas *c,
+                     int x, int y, unsigned int cp, int scale)
+{
+    text_init();
+    draw_glyph(c, x, y, cp, scale, text_ink(c));
+}
+
+// Draws up to end, or up to the NUL when end is NULL
+static void draw_text_to(Canvas *c,
+                         int x, int y, const char *s, const char *end, int scale)
+{
+    int size = BITMAP_SIZE * scale;
+    // the whole line is above, below or right of this canvas
+    if (y + size <= c->y0 || y >= c->y0 + c->h || x >= c->x0 + c->w)
+        return;
+
+    text_init();
+    int ink = text_ink(c);
+    while (end ? s < end : *s != '\0')
+    {
+        unsigned int cp = utf8_next(&s);
+        if (x + size > c->x0)
+            draw_glyph(c, x, y, cp, scale, ink);
+        x += size;
+        if (x >= c->x0 + c->w)
+            break;
     }
 }
 
+void draw_text_scale(Canvas *c,
+                     int x, int y, const char *s, int scale)
+{
+    draw_text_to(c, x, y, s, NULL, scale);
+}
+
+void draw_text_len(Canvas *c,
+                   int x, int y, const char *s, size_t len, int scale)
+{
+    draw_text_to(c, x, y, s, s + len, scale);
+}
+
 #endif /* IMG_UTIL_IMPLEMENTATION */
 #endif /* IMG_UTIL_H */
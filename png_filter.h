@@ -0,0 +1,399 @@
+#ifndef PNG_FILTER_H
+#define PNG_FILTER_H
+
+/* PNG scanline filters (None, Sub, Up, Average, Paeth).
+ *
+ * Every filter has a scalar version and, on x86 with GCC or Clang, SSE2 and
+ * AVX2 versions picked once at runtime from CPUID. They produce the same
+ * bytes, only faster. Rows are scored by the sum of |signed byte|, the
+ * heuristic stb_image_write uses.
+ */
+
+#include <stddef.h>
+
+typedef enum
+{
+    PNG_FILTER_ADAPTIVE, // try all five, keep the lowest score
+    PNG_FILTER_FLAT,     // Up for a repeated row, Sub for a one-colour row,
+                         // adaptive otherwise
+} PngFilterMode;
+
+// Filters row z of len bytes, bpp bytes per pixel, against the row above
+// (all zeros for the first row). bufs are two scratch rows of len + 1 bytes;
+// returns the one holding the filter type byte followed by the filtered row.
+unsigned char *png_filter_row(const unsigned char *z, const unsigned char *up, size_t len, int bpp,
+                              PngFilterMode mode, unsigned char *bufs[2]);
+
+// the instruction set the kernels run with: "avx2", "sse2" or "scalar"
+const char *png_filter_isa(void);
+
+#ifdef PNG_FILTER_IMPLEMENTATION
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PNG_FILTER_X86
+#include <immintrin.h>
+#endif
+
+typedef void (*png_filter_fn)(const unsigned char *z, const unsigned char *up, size_t len, int bpp, unsigned char *out);
+typedef unsigned long (*png_score_fn)(const unsigned char *p, size_t len);
+
+static unsigned char png_paeth(int a, int b, int c)
+{
+    int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return (unsigned char)a;
+    if (pb <= pc)
+        return (unsigned char)b;
+    return (unsigned char)c;
+}
+
+// scalar filters work on [from, len) so the SIMD ones can finish with them
+
+static void png_sub_tail(const unsigned char *z, const unsigned char *up, size_t from, size_t len, int bpp, unsigned char *out)
+{
+    (void)up;
+    for (size_t i = from; i < len; i++)
+        out[i] = (unsigned char)(z[i] - (i >= (size_t)bpp ? z[i - bpp] : 0));
+}
+
+static void png_up_tail(const unsigned char *z, const unsigned char *up, size_t from, size_t len, int bpp, unsigned char *out)
+{
+    (void)bpp;
+    for (size_t i = from; i < len; i++)
+        out[i] = (unsigned char)(z[i] - up[i]);
+}
+
+static void png_avg_tail(const unsigned char *z, const unsigned char *up, size_t from, size_t len, int bpp, unsigned char *out)
+{
+    for (size_t i = from; i < len; i++)
+        out[i] = (unsigned char)(z[i] - (((i >= (size_t)bpp ? z[i - bpp] : 0) + up[i]) >> 1));
+}
+
+static void png_paeth_tail(const unsigned char *z, const unsigned char *up, size_t from, size_t len, int bpp, unsigned char *out)
+{
+    for (size_t i = from; i < len; i++)
+    {
+        int a = i >= (size_t)bpp ? z[i - bpp] : 0;
+        int c = i >= (size_t)bpp ? up[i - bpp] : 0;
+        out[i] = (unsigned char)(z[i] - png_paeth(a, up[i], c));
+    }
+}
+
+static unsigned long png_score_tail(const unsigned char *p, size_t from, size_t len)
+{
+    unsigned long s = 0;
+    for (size_t i = from; i < len; i++)
+        s += (unsigned long)abs((signed char)p[i]);
+    return s;
+}
+
+static void png_none_scalar(const unsigned char *z, const unsigned char *up, size_t len, int bpp, unsigned char *out)
+{
+    (void)up;
+    (void)bpp;
+    memcpy(out, z, len);
+}
+
+static void png_sub_scalar(const unsigned char *z, const unsigned char *up, size_t len, int bpp, unsigned char *out)
+{
+    png_sub_tail(z, up, 0, len, bpp, out);
+}
+
+static void png_up_scalar(const unsigned char *z, const unsigned char *up, size_t len, int bpp, unsigned char *out)
+{
+    png_up_tail(z, up, 0, len, bpp, out);
+}
+
+static void png_avg_scalar(const unsigned char *z, const unsigned char *up, size_t len, int bpp, unsigned char *out)
+{
+    png_avg_tail(z, up, 0, len, bpp, out);
+}
+
+static void png_paeth_scalar(const unsigned char *z, const unsigned char *up, size_t len, int bpp, unsigned char *out)
+{
+    png_paeth_tail(z, up, 0, len, bpp, out);
+}
+
+static unsigned long png_score_scalar(const unsigned char *p, size_t len)
+{
+    return png_score_tail(p, 0, len);
+}
+
+#ifdef PNG_FILTER_X86
+// Encoding has no carried dependency: every byte only reads the unfiltered
+// rows, so the first bpp bytes are done scalar and the rest 16/32 at a time.
+
+__attribute__((target("sse2"))) static void png_sub_sse2(const unsigned char *z, const unsigned char *up, size_t len, int bpp, unsigned char *out)
+{
+    size_t i = (size_t)bpp < len ? (size_t)bpp : len;
+    png_sub_tail(z, up, 0, i, bpp, out);
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(z + i));
+        __m128i a = _mm_loadu_si128((const __m128i *)(z + i - bpp));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_sub_epi8(x, a));
+    }
+    png_sub_tail(z, up, i, len, bpp, out);
+}
+
+__attribute__((target("sse2"))) static void png_up_sse2(const unsigned char *z, const unsigned char *up, size_t len, int bpp, unsigned char *out)
+{
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(z + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(up + i));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_sub_epi8(x, b));
+    }
+    png_up_tail(z, up, i, len, bpp, out);
+}
+
+__attribute__((target("sse2"))) static void png_avg_sse2(const unsigned char *z, const unsigned char *up, size_t len, int bpp, unsigned char *out)
+{
+    size_t i = (size_t)bpp < len ? (size_t)bpp : len;
+    png_avg_tail(z, up, 0, i, bpp, out);
+    const __m128i one = _mm_set1_epi8(1);
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(z + i));
+        __m128i a = _mm_loadu_si128((const __m128i *)(z + i - bpp));
+        __m128i b = _mm_loadu_si128((const __m128i *)(up + i));
+        // avg_epu8 rounds up, PNG rounds down
+        __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_sub_epi8(x, avg));
+    }
+    png_avg_tail(z, up, i, len, bpp, out);
+}
+
+__attribute__((target("sse2"))) static __m128i png_paeth_pred_sse2(__m128i a, __m128i b, __m128i c)
+{
+    // p = a + b - c, so |p - a| = |b - c|, |p - b| = |a - c|, |p - c| = |a + b - 2c|
+    __m128i zero = _mm_setzero_si128();
+    __m128i pa = _mm_sub_epi16(b, c);
+    __m128i pb = _mm_sub_epi16(a, c);
+    __m128i pc = _mm_add_epi16(pa, pb);
+    pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+    pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+    pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+
+    __m128i not_a = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+    __m128i not_b = _mm_cmpgt_epi16(pb, pc);
+    __m128i bc = _mm_or_si128(_mm_andnot_si128(not_b, b), _mm_and_si128(not_b, c));
+    return _mm_or_si128(_mm_andnot_si128(not_a, a), _mm_and_si128(not_a, bc));
+}
+
+__attribute__((target("sse2"))) static void png_paeth_sse2(const unsigned char *z, const unsigned char *up, size_t len, int bpp, unsigned char *out)
+{
+    size_t i = (size_t)bpp < len ? (size_t)bpp : len;
+    png_paeth_tail(z, up, 0, i, bpp, out);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(z + i));
+        __m128i a = _mm_loadu_si128((const __m128i *)(z + i - bpp));
+        __m128i b = _mm_loadu_si128((const __m128i *)(up + i));
+        __m128i c = _mm_loadu_si128((const __m128i *)(up + i - bpp));
+        __m128i lo = png_paeth_pred_sse2(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+        __m128i hi = png_paeth_pred_sse2(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_sub_epi8(x, _mm_packus_epi16(lo, hi)));
+    }
+    png_paeth_tail(z, up, i, len, bpp, out);
+}
+
+__attribute__((target("sse2"))) static unsigned long png_score_sse2(const unsigned char *p, size_t len)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i neg = _mm_cmpgt_epi8(zero, x);
+        __m128i abs = _mm_sub_epi8(_mm_xor_si128(x, neg), neg); // -128 becomes 128 unsigned
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(abs, zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return (unsigned long)(lanes[0] + lanes[1]) + png_score_tail(p, i, len);
+}
+
+__attribute__((target("avx2"))) static void png_sub_avx2(const unsigned char *z, const unsigned char *up, size_t len, int bpp, unsigned char *out)
+{
+    size_t i = (size_t)bpp < len ? (size_t)bpp : len;
+    png_sub_tail(z, up, 0, i, bpp, out);
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(z + i));
+        __m256i a = _mm256_loadu_si256((const __m256i *)(z + i - bpp));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_sub_epi8(x, a));
+    }
+    png_sub_tail(z, up, i, len, bpp, out);
+}
+
+__attribute__((target("avx2"))) static void png_up_avx2(const unsigned char *z, const unsigned char *up, size_t len, int bpp, unsigned char *out)
+{
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(z + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(up + i));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_sub_epi8(x, b));
+    }
+    png_up_tail(z, up, i, len, bpp, out);
+}
+
+__attribute__((target("avx2"))) static void png_avg_avx2(const unsigned char *z, const unsigned char *up, size_t len, int bpp, unsigned char *out)
+{
+    size_t i = (size_t)bpp < len ? (size_t)bpp : len;
+    png_avg_tail(z, up, 0, i, bpp, out);
+    const __m256i one = _mm256_set1_epi8(1);
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(z + i));
+        __m256i a = _mm256_loadu_si256((const __m256i *)(z + i - bpp));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(up + i));
+        __m256i avg = _mm256_sub_epi8(_mm256_avg_epu8(a, b), _mm256_and_si256(_mm256_xor_si256(a, b), one));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_sub_epi8(x, avg));
+    }
+    png_avg_tail(z, up, i, len, bpp, out);
+}
+
+__attribute__((target("avx2"))) static void png_paeth_avx2(const unsigned char *z, const unsigned char *up, size_t len, int bpp, unsigned char *out)
+{
+    size_t i = (size_t)bpp < len ? (size_t)bpp : len;
+    png_paeth_tail(z, up, 0, i, bpp, out);
+    for (; i + 16 <= len; i += 16)
+    {
+        // 16 pixels widened to 16 bits fill one register
+        __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(z + i - bpp)));
+        __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(up + i)));
+        __m256i c = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(up + i - bpp)));
+        __m256i pa = _mm256_abs_epi16(_mm256_sub_epi16(b, c));
+        __m256i pb = _mm256_abs_epi16(_mm256_sub_epi16(a, c));
+        __m256i pc = _mm256_abs_epi16(_mm256_sub_epi16(_mm256_add_epi16(a, b), _mm256_add_epi16(c, c)));
+
+        __m256i not_a = _mm256_or_si256(_mm256_cmpgt_epi16(pa, pb), _mm256_cmpgt_epi16(pa, pc));
+        __m256i not_b = _mm256_cmpgt_epi16(pb, pc);
+        __m256i pred = _mm256_blendv_epi8(a, _mm256_blendv_epi8(b, c, not_b), not_a);
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(pred), _mm256_extracti128_si256(pred, 1));
+
+        __m128i x = _mm_loadu_si128((const __m128i *)(z + i));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_sub_epi8(x, packed));
+    }
+    png_paeth_tail(z, up, i, len, bpp, out);
+}
+
+__attribute__((target("avx2"))) static unsigned long png_score_avx2(const unsigned char *p, size_t len)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(p + i));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_abs_epi8(x), zero));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    return (unsigned long)(lanes[0] + lanes[1] + lanes[2] + lanes[3]) + png_score_tail(p, i, len);
+}
+#endif /* PNG_FILTER_X86 */
+
+static png_filter_fn png_filters[5];
+static png_score_fn png_score;
+static const char *png_isa;
+
+static void png_filter_init(void)
+{
+    if (png_score)
+        return;
+
+    png_filters[0] = png_none_scalar;
+    png_filters[1] = png_sub_scalar;
+    png_filters[2] = png_up_scalar;
+    png_filters[3] = png_avg_scalar;
+    png_filters[4] = png_paeth_scalar;
+    png_score = png_score_scalar;
+    png_isa = "scalar";
+
+#ifdef PNG_FILTER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        png_filters[1] = png_sub_avx2;
+        png_filters[2] = png_up_avx2;
+        png_filters[3] = png_avg_avx2;
+        png_filters[4] = png_paeth_avx2;
+        png_score = png_score_avx2;
+        png_isa = "avx2";
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        png_filters[1] = png_sub_sse2;
+        png_filters[2] = png_up_sse2;
+        png_filters[3] = png_avg_sse2;
+        png_filters[4] = png_paeth_sse2;
+        png_score = png_score_sse2;
+        png_isa = "sse2";
+    }
+#endif
+}
+
+const char *png_filter_isa(void)
+{
+    png_filter_init();
+    return png_isa;
+}
+
+// every pixel equal to the first one
+static bool png_row_uniform(const unsigned char *z, size_t len, int bpp)
+{
+    return len <= (size_t)bpp || memcmp(z, z + bpp, len - bpp) == 0;
+}
+
+unsigned char *png_filter_row(const unsigned char *z, const unsigned char *up, size_t len, int bpp,
+                              PngFilterMode mode, unsigned char *bufs[2])
+{
+    png_filter_init();
+
+    if (mode == PNG_FILTER_FLAT)
+    {
+        int type = -1;
+        if (memcmp(z, up, len) == 0)
+            type = 2;
+        else if (png_row_uniform(z, len, bpp))
+            type = 1;
+        if (type >= 0)
+        {
+            bufs[0][0] = (unsigned char)type;
+            png_filters[type](z, up, len, bpp, bufs[0] + 1);
+            return bufs[0];
+        }
+    }
+
+    // lowest score wins, earlier filter on a tie; nothing beats a zero
+    int best = -1;
+    unsigned long best_score = 0;
+    for (int type = 0; type < 5; type++)
+    {
+        unsigned char *cand = bufs[best == 0 ? 1 : 0];
+        png_filters[type](z, up, len, bpp, cand + 1);
+        unsigned long score = png_score(cand + 1, len);
+        if (best < 0 || score < best_score)
+        {
+            cand[0] = (unsigned char)type;
+            best = cand == bufs[0] ? 0 : 1;
+            best_score = score;
+            if (score == 0)
+                break;
+        }
+    }
+    return bufs[best];
+}
+
+#endif /* PNG_FILTER_IMPLEMENTATION */
+#endif /* PNG_FILTER_H */
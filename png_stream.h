@@ -0,0 +1,320 @@
+#ifndef PNG_STREAM_H
+#define PNG_STREAM_H
+
+/* Streaming PNG writer.
+ *
+ * Rows are pushed as they are produced: each one is filtered against the
+ * previous row, deflated (deflate.h) and written out in IDAT chunks as
+ * soon as a chunk fills up. Memory is two rows plus the window,
+ * whatever the size of the image.
+ *
+ * When pzlib.h is included first, the rows are deflated by its stream on
+ * the pool instead, which adds a PZLIB_CHUNK_SIZE piece per worker.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "png_filter.h"
+
+typedef struct PngStream PngStream;
+
+// channels: 1 grey, 3 RGB, 4 RGBA
+PngStream *png_stream_open(const char *path, int w, int h, int channels);
+
+// palette image, rows still come one byte per pixel and are packed to
+// depth (1, 2, 4 or 8) bits; palette colours are 0xRRGGBB
+PngStream *png_stream_open_indexed(const char *path, int w, int h, int depth,
+                                   const unsigned int *palette, int palette_cnt);
+
+// PNG_FILTER_ADAPTIVE unless changed, before the first row
+void png_stream_set_filter(PngStream *s, PngFilterMode mode);
+
+// rows must be the next cnt rows of the image, stride bytes apart
+bool png_stream_write_rows(PngStream *s, const unsigned char *rows, int cnt, size_t stride);
+
+// writes the end of the image once every row was given, frees s either way
+bool png_stream_close(PngStream *s);
+
+#ifdef PNG_STREAM_IMPLEMENTATION
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checksum.h"
+#include "deflate.h"
+
+#define PNGS_IDAT_SIZE DEFLATE_OUT_SIZE
+
+struct PngStream
+{
+    FILE *f;
+    int w;
+    int h;
+    int channels;
+    int depth;
+    size_t row_bytes; // packed
+    int rows_done;
+    bool ok;
+
+    PngFilterMode filter;
+    unsigned char *packed;   // row at depth bits per pixel, when below 8
+    unsigned char *prev_row; // zeros before the first row
+    unsigned char *bufs[2];  // filter byte + filtered row
+
+#ifdef PZLIB_H
+    PzlibStream *z;
+#else
+    Deflate *z;
+#endif
+    uint32_t adler; // of everything given to z
+    unsigned char out[PNGS_IDAT_SIZE];
+    size_t out_len;
+};
+
+static void pngs_put32(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static void pngs_chunk(PngStream *s, const char *type, const unsigned char *data, size_t len)
+{
+    unsigned char hdr[8];
+    pngs_put32(hdr, (uint32_t)len);
+    memcpy(hdr + 4, type, 4);
+
+    uint32_t crc = crc32_update(0, hdr + 4, 4);
+    crc = crc32_update(crc, data, len);
+    unsigned char tail[4];
+    pngs_put32(tail, crc);
+
+    if (fwrite(hdr, 1, 8, s->f) != 8 ||
+        (len && fwrite(data, 1, len, s->f) != len) ||
+        fwrite(tail, 1, 4, s->f) != 4)
+    {
+        s->ok = false;
+    }
+}
+
+// Queues compressed bytes, writing an IDAT chunk whenever one fills up
+static void pngs_write(PngStream *s, const unsigned char *data, size_t len)
+{
+    while (len > 0)
+    {
+        size_t n = PNGS_IDAT_SIZE - s->out_len;
+        if (n > len)
+            n = len;
+        memcpy(s->out + s->out_len, data, n);
+        s->out_len += n;
+        data += n;
+        len -= n;
+        if (s->out_len == PNGS_IDAT_SIZE)
+        {
+            pngs_chunk(s, "IDAT", s->out, s->out_len);
+            s->out_len = 0;
+        }
+    }
+}
+
+static void pngs_deflate_out(void *user, const unsigned char *data, size_t len)
+{
+    pngs_write((PngStream *)user, data, len);
+}
+
+static void pngs_deflate_data(PngStream *s, const unsigned char *data, size_t len)
+{
+#ifdef PZLIB_H
+    if (!pzlib_stream_write(s->z, data, len))
+        s->ok = false;
+#else
+    deflate_write(s->z, data, len);
+#endif
+    s->adler = adler32_update(s->adler, data, len);
+}
+
+static void pngs_deflate_finish(PngStream *s)
+{
+#ifdef PZLIB_H
+    if (!pzlib_stream_finish(s->z))
+        s->ok = false;
+#else
+    deflate_flush(s->z, true);
+#endif
+}
+
+static PngStream *pngs_open(const char *path, int w, int h, int depth, int color_type, int channels,
+                            const unsigned int *palette, int palette_cnt)
+{
+    PngStream *s = (PngStream *)calloc(1, sizeof(PngStream));
+    if (!s)
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+        return NULL;
+    }
+    s->w = w;
+    s->h = h;
+    s->channels = channels;
+    s->depth = depth;
+    s->row_bytes = ((size_t)w * channels * depth + 7) / 8;
+    s->ok = true;
+    s->prev_row = (unsigned char *)calloc(s->row_bytes, 1);
+    s->bufs[0] = (unsigned char *)malloc(s->row_bytes + 1);
+    s->bufs[1] = (unsigned char *)malloc(s->row_bytes + 1);
+    s->packed = depth < 8 ? (unsigned char *)malloc(s->row_bytes) : NULL;
+#ifdef PZLIB_H
+    s->z = pzlib_stream_create(DEFLATE_DEFAULT_LEVEL, pngs_deflate_out, s);
+#else
+    s->z = deflate_create(DEFLATE_DEFAULT_LEVEL, pngs_deflate_out, s);
+#endif
+    s->f = fopen(path, "wb");
+    if (!s->prev_row || !s->bufs[0] || !s->bufs[1] || (depth < 8 && !s->packed) || !s->z || !s->f)
+    {
+        fprintf(stderr, "ERROR: FAILED TO OPEN %s\n", path);
+        s->ok = false;
+        png_stream_close(s);
+        return NULL;
+    }
+    s->adler = 1;
+
+    static const unsigned char sig[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    fwrite(sig, 1, 8, s->f);
+
+    unsigned char ihdr[13];
+    pngs_put32(ihdr, (uint32_t)w);
+    pngs_put32(ihdr + 4, (uint32_t)h);
+    ihdr[8] = (unsigned char)depth;
+    ihdr[9] = (unsigned char)color_type;
+    ihdr[10] = 0;
+    ihdr[11] = 0;
+    ihdr[12] = 0;
+    pngs_chunk(s, "IHDR", ihdr, 13);
+
+    if (palette)
+    {
+        unsigned char plte[256 * 3];
+        for (int i = 0; i < palette_cnt; i++)
+        {
+            plte[i * 3] = (unsigned char)(palette[i] >> 16);
+            plte[i * 3 + 1] = (unsigned char)(palette[i] >> 8);
+            plte[i * 3 + 2] = (unsigned char)palette[i];
+        }
+        pngs_chunk(s, "PLTE", plte, (size_t)palette_cnt * 3);
+    }
+
+    static const unsigned char zlib_hdr[2] = {0x78, 0x5e};
+    pngs_write(s, zlib_hdr, 2);
+    return s;
+}
+
+PngStream *png_stream_open(const char *path, int w, int h, int channels)
+{
+    static const int ctype[5] = {-1, 0, 4, 2, 6};
+    if (w <= 0 || h <= 0 || channels < 1 || channels > 4)
+    {
+        fprintf(stderr, "ERROR: BAD PNG SIZE\n");
+        return NULL;
+    }
+    return pngs_open(path, w, h, 8, ctype[channels], channels, NULL, 0);
+}
+
+PngStream *png_stream_open_indexed(const char *path, int w, int h, int depth,
+                                   const unsigned int *palette, int palette_cnt)
+{
+    if (w <= 0 || h <= 0 || (depth != 1 && depth != 2 && depth != 4 && depth != 8) ||
+        palette_cnt < 1 || palette_cnt > (1 << depth))
+    {
+        fprintf(stderr, "ERROR: BAD PNG SIZE\n");
+        return NULL;
+    }
+    return pngs_open(path, w, h, depth, 3, 1, palette, palette_cnt);
+}
+
+// packs one index per byte into depth bits per pixel, leftmost pixel highest
+static void pngs_pack(const unsigned char *src, int w, int depth, unsigned char *dst)
+{
+    int per_byte = 8 / depth;
+    for (int x = 0; x < w; x += per_byte)
+    {
+        unsigned char b = 0;
+        for (int k = 0; k < per_byte; k++)
+        {
+            b <<= depth;
+            if (x + k < w)
+                b |= src[x + k];
+        }
+        *dst++ = b;
+    }
+}
+
+void png_stream_set_filter(PngStream *s, PngFilterMode mode)
+{
+    s->filter = mode;
+}
+
+bool png_stream_write_rows(PngStream *s, const unsigned char *rows, int cnt, size_t stride)
+{
+    for (int r = 0; r < cnt && s->ok; r++)
+    {
+        if (s->rows_done == s->h)
+        {
+            fprintf(stderr, "ERROR: TOO MANY PNG ROWS\n");
+            s->ok = false;
+            break;
+        }
+        const unsigned char *z = rows + stride * r;
+        if (s->packed)
+        {
+            pngs_pack(z, s->w, s->depth, s->packed);
+            z = s->packed;
+        }
+
+        // sub-byte pixels are filtered a byte at a time
+        int bpp = s->depth < 8 ? 1 : s->channels;
+        unsigned char *f = png_filter_row(z, s->prev_row, s->row_bytes, bpp, s->filter, s->bufs);
+        pngs_deflate_data(s, f, s->row_bytes + 1);
+        memcpy(s->prev_row, z, s->row_bytes);
+        s->rows_done++;
+    }
+    return s->ok;
+}
+
+bool png_stream_close(PngStream *s)
+{
+    if (!s)
+        return false;
+
+    bool ok = s->ok && s->rows_done == s->h;
+    if (s->f && s->ok)
+    {
+        if (s->rows_done != s->h)
+            fprintf(stderr, "ERROR: PNG GOT %d OF %d ROWS\n", s->rows_done, s->h);
+
+        pngs_deflate_finish(s);
+        unsigned char trailer[4];
+        pngs_put32(trailer, s->adler);
+        pngs_write(s, trailer, 4);
+        if (s->out_len)
+            pngs_chunk(s, "IDAT", s->out, s->out_len);
+        pngs_chunk(s, "IEND", NULL, 0);
+        ok = ok && s->ok;
+    }
+
+    if (s->f && fclose(s->f) != 0)
+        ok = false;
+    free(s->prev_row);
+    free(s->bufs[0]);
+    free(s->bufs[1]);
+    free(s->packed);
+#ifdef PZLIB_H
+    pzlib_stream_destroy(s->z);
+#else
+    deflate_destroy(s->z);
+#endif
+    free(s);
+    return ok;
+}
+
+#endif /* PNG_STREAM_IMPLEMENTATION */
+#endif /* PNG_STREAM_H */
@@ -0,0 +1,347 @@
+#ifndef POOL_H
+#define POOL_H
+
+/* Work-stealing thread pool.
+ *
+ * Every worker owns a deque: tasks submitted from inside a worker go to the
+ * back of its own deque and are popped back first (depth first, warm cache),
+ * idle workers steal from the front of the others (oldest, usually biggest).
+ * Tasks submitted from outside the pool are spread round robin.
+ */
+
+typedef void (*pool_task_fn)(void *arg);
+
+typedef struct Pool Pool;
+
+// threads <= 0 uses every online cpu
+Pool *pool_create(int threads);
+
+void pool_submit(Pool *p, pool_task_fn fn, void *arg);
+
+// blocks until every submitted task, and every task they submitted, is done;
+// must not be called from inside a task
+void pool_wait(Pool *p);
+
+void pool_destroy(Pool *p);
+
+int pool_size(Pool *p);
+
+// index of the calling worker in [0, pool_size), -1 outside the pool
+int pool_worker_id(Pool *p);
+
+#ifdef POOL_IMPLEMENTATION
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+typedef struct
+{
+    pool_task_fn fn;
+    void *arg;
+} PoolTask;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    PoolTask *tasks;
+    int cap;
+    int head; // first task (steal end)
+    int len;
+} PoolDeque;
+
+typedef struct
+{
+    Pool *pool;
+    int id;
+} PoolWorker;
+
+struct Pool
+{
+    int thread_cnt;
+    pthread_t *threads;
+    PoolWorker *workers;
+    PoolDeque *deques;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    atomic_int queued;  // tasks sitting in a deque
+    atomic_long pending; // tasks submitted and not finished
+    atomic_uint next_deque;
+    bool started; // thread_cnt is final, workers may look at the deques
+    bool stop;
+};
+
+static _Thread_local Pool *pool_tls_pool = NULL;
+static _Thread_local int pool_tls_id = -1;
+
+static bool pool_deque_push(PoolDeque *d, PoolTask t)
+{
+    pthread_mutex_lock(&d->lock);
+    if (d->len == d->cap)
+    {
+        int cap = d->cap ? d->cap * 2 : 64;
+        PoolTask *tasks = (PoolTask *)malloc(sizeof(PoolTask) * cap);
+        if (!tasks)
+        {
+            pthread_mutex_unlock(&d->lock);
+            return false;
+        }
+        for (int i = 0; i < d->len; i++)
+        {
+            tasks[i] = d->tasks[(d->head + i) % d->cap];
+        }
+        free(d->tasks);
+        d->tasks = tasks;
+        d->cap = cap;
+        d->head = 0;
+    }
+    d->tasks[(d->head + d->len) % d->cap] = t;
+    d->len++;
+    pthread_mutex_unlock(&d->lock);
+    return true;
+}
+
+static bool pool_deque_pop_back(PoolDeque *d, PoolTask *out)
+{
+    bool ok = false;
+    pthread_mutex_lock(&d->lock);
+    if (d->len > 0)
+    {
+        d->len--;
+        *out = d->tasks[(d->head + d->len) % d->cap];
+        ok = true;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+static bool pool_deque_pop_front(PoolDeque *d, PoolTask *out)
+{
+    bool ok = false;
+    pthread_mutex_lock(&d->lock);
+    if (d->len > 0)
+    {
+        *out = d->tasks[d->head];
+        d->head = (d->head + 1) % d->cap;
+        d->len--;
+        ok = true;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+static bool pool_find_task(Pool *p, int id, PoolTask *out)
+{
+    if (pool_deque_pop_back(&p->deques[id], out))
+    {
+        return true;
+    }
+    for (int i = 1; i < p->thread_cnt; i++)
+    {
+        if (pool_deque_pop_front(&p->deques[(id + i) % p->thread_cnt], out))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void pool_task_done(Pool *p)
+{
+    if (atomic_fetch_sub(&p->pending, 1) == 1)
+    {
+        pthread_mutex_lock(&p->lock);
+        pthread_cond_broadcast(&p->done_cond);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+static void *pool_worker_main(void *arg)
+{
+    PoolWorker *w = (PoolWorker *)arg;
+    Pool *p = w->pool;
+    pool_tls_pool = p;
+    pool_tls_id = w->id;
+
+    pthread_mutex_lock(&p->lock);
+    while (!p->started)
+    {
+        pthread_cond_wait(&p->work_cond, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    for (;;)
+    {
+        PoolTask t;
+        if (pool_find_task(p, w->id, &t))
+        {
+            atomic_fetch_sub(&p->queued, 1);
+            t.fn(t.arg);
+            pool_task_done(p);
+            continue;
+        }
+
+        pthread_mutex_lock(&p->lock);
+        while (atomic_load(&p->queued) == 0 && !p->stop)
+        {
+            pthread_cond_wait(&p->work_cond, &p->lock);
+        }
+        bool stop = p->stop;
+        pthread_mutex_unlock(&p->lock);
+        if (stop)
+        {
+            break;
+        }
+    }
+    return NULL;
+}
+
+Pool *pool_create(int threads)
+{
+    if (threads <= 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+
+    Pool *p = (Pool *)calloc(1, sizeof(Pool));
+    if (!p)
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+        return NULL;
+    }
+    p->thread_cnt = threads;
+    p->threads = (pthread_t *)calloc(threads, sizeof(pthread_t));
+    p->workers = (PoolWorker *)calloc(threads, sizeof(PoolWorker));
+    p->deques = (PoolDeque *)calloc(threads, sizeof(PoolDeque));
+    if (!p->threads || !p->workers || !p->deques)
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+        free(p->threads);
+        free(p->workers);
+        free(p->deques);
+        free(p);
+        return NULL;
+    }
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->work_cond, NULL);
+    pthread_cond_init(&p->done_cond, NULL);
+    atomic_init(&p->queued, 0);
+    atomic_init(&p->pending, 0);
+    atomic_init(&p->next_deque, 0);
+
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_mutex_init(&p->deques[i].lock, NULL);
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        p->workers[i].pool = p;
+        p->workers[i].id = i;
+        if (pthread_create(&p->threads[i], NULL, pool_worker_main, &p->workers[i]) != 0)
+        {
+            // run with the workers we got; none of them has looked at
+            // thread_cnt or the deques yet, they wait for started
+            fprintf(stderr, "ERROR: FAILED TO START WORKER %d\n", i);
+            p->thread_cnt = i;
+            // pool_destroy() only sees the started workers' deques
+            for (int k = i; k < threads; k++)
+            {
+                pthread_mutex_destroy(&p->deques[k].lock);
+            }
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&p->lock);
+    p->started = true;
+    pthread_cond_broadcast(&p->work_cond);
+    pthread_mutex_unlock(&p->lock);
+    if (p->thread_cnt == 0)
+    {
+        pool_destroy(p);
+        return NULL;
+    }
+    return p;
+}
+
+void pool_submit(Pool *p, pool_task_fn fn, void *arg)
+{
+    PoolTask t = {fn, arg};
+    int id = pool_worker_id(p);
+    if (id < 0)
+    {
+        id = (int)(atomic_fetch_add(&p->next_deque, 1) % (unsigned)p->thread_cnt);
+    }
+
+    atomic_fetch_add(&p->pending, 1);
+    atomic_fetch_add(&p->queued, 1);
+    if (!pool_deque_push(&p->deques[id], t))
+    {
+        // no room to queue it, run it here instead
+        atomic_fetch_sub(&p->queued, 1);
+        fn(arg);
+        pool_task_done(p);
+        return;
+    }
+
+    pthread_mutex_lock(&p->lock);
+    pthread_cond_signal(&p->work_cond);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_wait(Pool *p)
+{
+    pthread_mutex_lock(&p->lock);
+    while (atomic_load(&p->pending) > 0)
+    {
+        pthread_cond_wait(&p->done_cond, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_destroy(Pool *p)
+{
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    p->stop = true;
+    pthread_cond_broadcast(&p->work_cond);
+    pthread_mutex_unlock(&p->lock);
+
+    for (int i = 0; i < p->thread_cnt; i++)
+    {
+        pthread_join(p->threads[i], NULL);
+    }
+    for (int i = 0; i < p->thread_cnt; i++)
+    {
+        pthread_mutex_destroy(&p->deques[i].lock);
+        free(p->deques[i].tasks);
+    }
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->work_cond);
+    pthread_cond_destroy(&p->done_cond);
+    free(p->threads);
+    free(p->workers);
+    free(p->deques);
+    free(p);
+}
+
+int pool_size(Pool *p)
+{
+    return p->thread_cnt;
+}
+
+int pool_worker_id(Pool *p)
+{
+    return pool_tls_pool == p ? pool_tls_id : -1;
+}
+
+#endif /* POOL_IMPLEMENTATION */
+#endif /* POOL_H */
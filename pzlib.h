@@ -0,0 +1,409 @@
+#ifndef PZLIB_H
+#define PZLIB_H
+
+/* Parallel zlib compression, pigz style.
+ *
+ * The input is cut into PZLIB_CHUNK_SIZE pieces that are deflated on a pool
+ * at the same time. Each piece is primed with the 32K before it, so matches
+ * still cross the cuts, and ends with a sync flush, so the pieces can just
+ * be joined. The Adler-32s of the pieces are combined into the trailer.
+ * Same signature as stbi_zlib_compress(), to be used as STBIW_ZLIB_COMPRESS.
+ *
+ * The stream form does the same for data that comes a bit at a time, like
+ * PNG rows: a batch of one piece per worker is buffered, compressed at once
+ * and written out in order, so memory stays at the batch plus the window.
+ * The pieces are cut at the same offsets whatever the number of threads,
+ * so the output does not depend on it.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "pool.h"
+
+#define PZLIB_CHUNK_SIZE (128 * 1024)
+
+// pool the next calls compress on, NULL compresses serially
+void pzlib_set_pool(Pool *pool);
+
+// malloc'd zlib stream, NULL when out of memory
+unsigned char *pzlib_compress(unsigned char *data, int data_len, int *out_len, int quality);
+
+typedef void (*pzlib_out_fn)(void *user, const unsigned char *data, size_t len);
+
+typedef struct PzlibStream PzlibStream;
+
+// raw deflate, no zlib header or trailer, handed to out in order
+PzlibStream *pzlib_stream_create(int quality, pzlib_out_fn out, void *user);
+
+bool pzlib_stream_write(PzlibStream *z, const unsigned char *data, size_t len);
+
+// ends the deflate stream with what is still buffered
+bool pzlib_stream_finish(PzlibStream *z);
+
+void pzlib_stream_destroy(PzlibStream *z);
+
+#ifdef PZLIB_IMPLEMENTATION
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checksum.h"
+#include "deflate.h"
+
+typedef struct
+{
+    unsigned char *data;
+    size_t cap;
+    size_t len;
+    bool failed;
+} PzlibBuf;
+
+typedef struct PzlibJob PzlibJob;
+
+typedef struct
+{
+    PzlibJob *job;
+    size_t off;
+    size_t len;
+    bool last;
+    uint32_t adler;
+    PzlibBuf out;
+} PzlibPiece;
+
+struct PzlibJob
+{
+    Pool *pool;
+    const unsigned char *data;
+    int level;
+    Deflate **coders; // one per worker, made on first use
+};
+
+static Pool *pzlib_pool = NULL;
+
+void pzlib_set_pool(Pool *pool)
+{
+    pzlib_pool = pool;
+}
+
+static void pzlib_out(void *user, const unsigned char *data, size_t len)
+{
+    PzlibBuf *b = (PzlibBuf *)user;
+    if (b->failed)
+        return;
+    if (b->len + len > b->cap)
+    {
+        size_t cap = b->cap ? b->cap : 4096;
+        while (cap < b->len + len)
+            cap *= 2;
+        unsigned char *p = (unsigned char *)realloc(b->data, cap);
+        if (!p)
+        {
+            b->failed = true;
+            return;
+        }
+        b->data = p;
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+}
+
+#define PZLIB_WINDOW 32768
+
+static void pzlib_piece(PzlibPiece *pc, Deflate *z)
+{
+    const unsigned char *src = pc->job->data + pc->off;
+    size_t dict = pc->off < PZLIB_WINDOW ? pc->off : PZLIB_WINDOW;
+    if (dict)
+        deflate_dictionary(z, src - dict, dict);
+    deflate_write(z, src, pc->len);
+    deflate_flush(z, pc->last);
+    pc->adler = adler32_update(1, src, pc->len);
+}
+
+static void pzlib_task(void *arg)
+{
+    PzlibPiece *pc = (PzlibPiece *)arg;
+    PzlibJob *job = pc->job;
+    int id = pool_worker_id(job->pool);
+
+    // ran inline by pool_submit() when it could not queue
+    if (id < 0)
+    {
+        Deflate *z = deflate_create(job->level, pzlib_out, &pc->out);
+        if (!z)
+        {
+            pc->out.failed = true;
+            return;
+        }
+        pzlib_piece(pc, z);
+        deflate_destroy(z);
+        return;
+    }
+
+    // the coder is per worker, the output per piece
+    Deflate *z = job->coders[id];
+    if (!z)
+    {
+        z = deflate_create(job->level, pzlib_out, NULL);
+        job->coders[id] = z;
+        if (!z)
+        {
+            pc->out.failed = true;
+            return;
+        }
+    }
+    deflate_reset(z, &pc->out);
+    pzlib_piece(pc, z);
+}
+
+unsigned char *pzlib_compress(unsigned char *data, int data_len, int *out_len, int quality)
+{
+    size_t len = data_len > 0 ? (size_t)data_len : 0;
+    size_t cnt = len / PZLIB_CHUNK_SIZE + 1;
+    if (len && len % PZLIB_CHUNK_SIZE == 0)
+        cnt--;
+
+    PzlibJob job;
+    job.pool = NULL;
+    job.data = data;
+    job.level = quality;
+    job.coders = NULL;
+
+    PzlibPiece *pieces = (PzlibPiece *)calloc(cnt, sizeof(PzlibPiece));
+    if (!pieces)
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+        return NULL;
+    }
+    for (size_t i = 0; i < cnt; i++)
+    {
+        pieces[i].job = &job;
+        pieces[i].off = i * PZLIB_CHUNK_SIZE;
+        pieces[i].len = i + 1 < cnt ? PZLIB_CHUNK_SIZE : len - pieces[i].off;
+        pieces[i].last = i + 1 == cnt;
+    }
+
+    if (cnt > 1 && pzlib_pool)
+    {
+        job.coders = (Deflate **)calloc(pool_size(pzlib_pool), sizeof(Deflate *));
+        if (job.coders)
+            job.pool = pzlib_pool;
+    }
+
+    if (job.pool)
+    {
+        for (size_t i = 0; i < cnt; i++)
+            pool_submit(job.pool, pzlib_task, &pieces[i]);
+        pool_wait(job.pool);
+        for (int i = 0; i < pool_size(job.pool); i++)
+            deflate_destroy(job.coders[i]);
+        free(job.coders);
+    }
+    else
+    {
+        // one piece, or no threads to spread over
+        Deflate *z = deflate_create(quality, pzlib_out, NULL);
+        for (size_t i = 0; i < cnt; i++)
+        {
+            if (!z)
+            {
+                pieces[i].out.failed = true;
+                continue;
+            }
+            deflate_reset(z, &pieces[i].out);
+            pzlib_piece(&pieces[i], z);
+        }
+        deflate_destroy(z);
+    }
+
+    size_t total = 2 + 4;
+    bool ok = true;
+    for (size_t i = 0; i < cnt; i++)
+    {
+        total += pieces[i].out.len;
+        ok = ok && !pieces[i].out.failed;
+    }
+
+    unsigned char *out = ok && total <= INT32_MAX ? (unsigned char *)malloc(total) : NULL;
+    if (out)
+    {
+        size_t n = 0;
+        out[n++] = 0x78;
+        out[n++] = 0x5e;
+        uint32_t adler = 1;
+        for (size_t i = 0; i < cnt; i++)
+        {
+            memcpy(out + n, pieces[i].out.data, pieces[i].out.len);
+            n += pieces[i].out.len;
+            adler = adler32_combine(adler, pieces[i].adler, pieces[i].len);
+        }
+        out[n++] = (unsigned char)(adler >> 24);
+        out[n++] = (unsigned char)(adler >> 16);
+        out[n++] = (unsigned char)(adler >> 8);
+        out[n++] = (unsigned char)adler;
+        *out_len = (int)n;
+    }
+    else
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+    }
+
+    for (size_t i = 0; i < cnt; i++)
+        free(pieces[i].out.data);
+    free(pieces);
+    return out;
+}
+
+struct PzlibStream
+{
+    PzlibJob job;       // job.data is buf
+    Deflate *serial;    // without a pool
+    unsigned char *buf; // the window so far, then the batch
+    size_t hist;
+    size_t len; // of the batch
+    size_t piece_cnt;
+    PzlibPiece *pieces;
+    pzlib_out_fn out;
+    void *user;
+    bool ok;
+};
+
+PzlibStream *pzlib_stream_create(int quality, pzlib_out_fn out, void *user)
+{
+    PzlibStream *z = (PzlibStream *)calloc(1, sizeof(PzlibStream));
+    if (!z)
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+        return NULL;
+    }
+    z->out = out;
+    z->user = user;
+    z->ok = true;
+    z->job.level = quality;
+    if (pzlib_pool && pool_size(pzlib_pool) > 1)
+    {
+        z->job.coders = (Deflate **)calloc(pool_size(pzlib_pool), sizeof(Deflate *));
+        z->piece_cnt = (size_t)pool_size(pzlib_pool);
+    }
+    if (z->job.coders)
+    {
+        z->job.pool = pzlib_pool;
+    }
+    else
+    {
+        z->piece_cnt = 1;
+        z->serial = deflate_create(quality, pzlib_out, NULL);
+    }
+    z->buf = (unsigned char *)malloc(PZLIB_WINDOW + z->piece_cnt * PZLIB_CHUNK_SIZE);
+    z->pieces = (PzlibPiece *)calloc(z->piece_cnt, sizeof(PzlibPiece));
+    z->job.data = z->buf;
+    if (!z->buf || !z->pieces || (!z->job.pool && !z->serial))
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+        pzlib_stream_destroy(z);
+        return NULL;
+    }
+    return z;
+}
+
+// Compresses the batch, one piece per chunk, and keeps its last window
+static void pzlib_stream_batch(PzlibStream *z, bool final)
+{
+    size_t cnt = (z->len + PZLIB_CHUNK_SIZE - 1) / PZLIB_CHUNK_SIZE;
+    if (cnt == 0 && final)
+        cnt = 1; // just the last block
+    for (size_t i = 0; i < cnt; i++)
+    {
+        PzlibPiece *pc = &z->pieces[i];
+        pc->job = &z->job;
+        pc->off = z->hist + i * PZLIB_CHUNK_SIZE;
+        pc->len = i + 1 < cnt ? PZLIB_CHUNK_SIZE : z->hist + z->len - pc->off;
+        pc->last = final && i + 1 == cnt;
+        pc->out.len = 0;
+        pc->out.failed = false;
+    }
+
+    if (z->job.pool)
+    {
+        for (size_t i = 0; i < cnt; i++)
+            pool_submit(z->job.pool, pzlib_task, &z->pieces[i]);
+        pool_wait(z->job.pool);
+    }
+    else
+    {
+        for (size_t i = 0; i < cnt; i++)
+        {
+            deflate_reset(z->serial, &z->pieces[i].out);
+            pzlib_piece(&z->pieces[i], z->serial);
+        }
+    }
+
+    for (size_t i = 0; i < cnt; i++)
+    {
+        if (z->pieces[i].out.failed)
+        {
+            fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+            z->ok = false;
+            return;
+        }
+        z->out(z->user, z->pieces[i].out.data, z->pieces[i].out.len);
+    }
+
+    size_t total = z->hist + z->len;
+    size_t keep = total < PZLIB_WINDOW ? total : PZLIB_WINDOW;
+    memmove(z->buf, z->buf + total - keep, keep);
+    z->hist = keep;
+    z->len = 0;
+}
+
+bool pzlib_stream_write(PzlibStream *z, const unsigned char *data, size_t len)
+{
+    size_t cap = z->piece_cnt * PZLIB_CHUNK_SIZE;
+    while (len > 0 && z->ok)
+    {
+        // a full batch waits for more data, the last piece has to be final
+        if (z->len == cap)
+        {
+            pzlib_stream_batch(z, false);
+            continue;
+        }
+        size_t n = cap - z->len;
+        if (n > len)
+            n = len;
+        memcpy(z->buf + z->hist + z->len, data, n);
+        z->len += n;
+        data += n;
+        len -= n;
+    }
+    return z->ok;
+}
+
+bool pzlib_stream_finish(PzlibStream *z)
+{
+    if (z->ok)
+        pzlib_stream_batch(z, true);
+    return z->ok;
+}
+
+void pzlib_stream_destroy(PzlibStream *z)
+{
+    if (!z)
+        return;
+
+    if (z->job.pool)
+    {
+        for (int i = 0; i < pool_size(z->job.pool); i++)
+            deflate_destroy(z->job.coders[i]);
+    }
+    free(z->job.coders);
+    deflate_destroy(z->serial);
+    for (size_t i = 0; z->pieces && i < z->piece_cnt; i++)
+        free(z->pieces[i].out.data);
+    free(z->pieces);
+    free(z->buf);
+    free(z);
+}
+
+#endif /* PZLIB_IMPLEMENTATION */
+#endif /* PZLIB_H */
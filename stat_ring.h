@@ -0,0 +1,325 @@
+#ifndef STAT_RING_H
+#define STAT_RING_H
+
+/* Batched statx() over io_uring.
+ *
+ * Requests are queued with stat_ring_submit() and stay in flight until the
+ * ring is full or stat_ring_drain() is called; every completion is handed to
+ * the callback given at creation. A ring belongs to one thread.
+ * Talks to the kernel through raw syscalls, so no liburing is needed.
+ *
+ * Only statx is batched: the scanner's openat and getdents stay blocking
+ * calls on the pool workers, which overlap them across directories.
+ */
+
+#include <stdbool.h>
+#include <linux/stat.h>
+
+// st is NULL and err the errno when the statx failed
+typedef void (*stat_ring_fn)(void *user, void *ctx, const struct statx *st, int err);
+
+typedef struct StatRing StatRing;
+
+// NULL when io_uring is not available (old kernel, seccomp, ...)
+StatRing *stat_ring_create(unsigned entries, stat_ring_fn fn);
+
+// statx(dirfd, name) with size and mtime; name must stay valid until the
+// callback ran
+void stat_ring_submit(StatRing *r, int dirfd, const char *name, void *user, void *ctx);
+
+// waits for every request queued so far
+void stat_ring_drain(StatRing *r);
+
+void stat_ring_destroy(StatRing *r);
+
+#ifdef STAT_RING_IMPLEMENTATION
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+struct StatRing
+{
+    int fd;
+    unsigned entries;
+    stat_ring_fn fn;
+
+    void *sq_ptr;
+    size_t sq_size;
+    void *cq_ptr;
+    size_t cq_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // one slot per request in flight
+    struct statx *bufs;
+    void **users;
+    void **ctxs;
+    unsigned *free_slots;
+    unsigned free_cnt;
+    unsigned inflight;
+    unsigned unsubmitted;
+    bool broken; // io_uring_enter failed, requests run synchronously
+};
+
+static int stat_ring_enter(StatRing *r, unsigned submit, unsigned wait)
+{
+    for (;;)
+    {
+        long ret = syscall(__NR_io_uring_enter, r->fd, submit, wait,
+                           wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (ret >= 0)
+        {
+            return (int)ret;
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            return -1;
+        }
+    }
+}
+
+static void stat_ring_reap(StatRing *r)
+{
+    unsigned head = *r->cq_head;
+    unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail)
+    {
+        struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+        unsigned slot = (unsigned)cqe->user_data;
+        if (cqe->res < 0)
+        {
+            r->fn(r->users[slot], r->ctxs[slot], NULL, -cqe->res);
+        }
+        else
+        {
+            r->fn(r->users[slot], r->ctxs[slot], &r->bufs[slot], 0);
+        }
+        r->free_slots[r->free_cnt++] = slot;
+        r->inflight--;
+        head++;
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static void stat_ring_flush(StatRing *r, unsigned wait)
+{
+    if (stat_ring_enter(r, r->unsubmitted, wait) < 0)
+    {
+        fprintf(stderr, "ERROR: io_uring_enter FAILED (%s)\n", strerror(errno));
+        r->broken = true;
+    }
+    r->unsubmitted = 0;
+    stat_ring_reap(r);
+
+    if (r->broken)
+    {
+        // whatever is still queued will never be reported, fail it now
+        for (unsigned slot = 0; slot < r->entries && r->inflight > 0; slot++)
+        {
+            bool used = true;
+            for (unsigned i = 0; i < r->free_cnt; i++)
+            {
+                if (r->free_slots[i] == slot)
+                {
+                    used = false;
+                    break;
+                }
+            }
+            if (used)
+            {
+                r->fn(r->users[slot], r->ctxs[slot], NULL, EIO);
+                r->free_slots[r->free_cnt++] = slot;
+                r->inflight--;
+            }
+        }
+    }
+}
+
+StatRing *stat_ring_create(unsigned entries, stat_ring_fn fn)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    StatRing *r = (StatRing *)calloc(1, sizeof(StatRing));
+    if (!r)
+    {
+        close(fd);
+        return NULL;
+    }
+    r->fd = fd;
+    r->entries = p.sq_entries;
+    r->fn = fn;
+
+    r->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (r->cq_size > r->sq_size)
+            r->sq_size = r->cq_size;
+        r->cq_size = r->sq_size;
+    }
+
+    r->sq_ptr = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED)
+    {
+        r->sq_ptr = NULL;
+        stat_ring_destroy(r);
+        return NULL;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        r->cq_ptr = r->sq_ptr;
+    }
+    else
+    {
+        r->cq_ptr = mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED)
+        {
+            r->cq_ptr = NULL;
+            stat_ring_destroy(r);
+            return NULL;
+        }
+    }
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = (struct io_uring_sqe *)mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+                                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED)
+    {
+        r->sqes = NULL;
+        stat_ring_destroy(r);
+        return NULL;
+    }
+
+    char *sq = (char *)r->sq_ptr;
+    char *cq = (char *)r->cq_ptr;
+    r->sq_head = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    r->bufs = (struct statx *)malloc(sizeof(struct statx) * r->entries);
+    r->users = (void **)malloc(sizeof(void *) * r->entries);
+    r->ctxs = (void **)malloc(sizeof(void *) * r->entries);
+    r->free_slots = (unsigned *)malloc(sizeof(unsigned) * r->entries);
+    if (!r->bufs || !r->users || !r->ctxs || !r->free_slots)
+    {
+        stat_ring_destroy(r);
+        return NULL;
+    }
+    for (unsigned i = 0; i < r->entries; i++)
+    {
+        r->free_slots[i] = r->entries - 1 - i;
+    }
+    r->free_cnt = r->entries;
+    return r;
+}
+
+void stat_ring_submit(StatRing *r, int dirfd, const char *name, void *user, void *ctx)
+{
+    if (r->broken)
+    {
+        struct statx st;
+        if (syscall(__NR_statx, dirfd, name, AT_SYMLINK_NOFOLLOW, STATX_SIZE | STATX_MTIME, &st) != 0)
+        {
+            r->fn(user, ctx, NULL, errno);
+        }
+        else
+        {
+            r->fn(user, ctx, &st, 0);
+        }
+        return;
+    }
+
+    while (r->free_cnt == 0)
+    {
+        stat_ring_flush(r, 1);
+    }
+
+    unsigned slot = r->free_slots[--r->free_cnt];
+    r->users[slot] = user;
+    r->ctxs[slot] = ctx;
+
+    unsigned tail = *r->sq_tail;
+    unsigned idx = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_STATX;
+    sqe->fd = dirfd;
+    sqe->addr = (unsigned long long)(uintptr_t)name;
+    sqe->len = STATX_SIZE | STATX_MTIME;
+    sqe->off = (unsigned long long)(uintptr_t)&r->bufs[slot];
+    sqe->statx_flags = AT_SYMLINK_NOFOLLOW;
+    sqe->user_data = slot;
+    r->sq_array[idx] = idx;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    r->inflight++;
+    r->unsubmitted++;
+    // hand the kernel work in batches instead of one syscall per file
+    if (r->unsubmitted >= r->entries / 4)
+    {
+        stat_ring_flush(r, 0);
+    }
+}
+
+void stat_ring_drain(StatRing *r)
+{
+    while (r->inflight > 0)
+    {
+        stat_ring_flush(r, r->inflight);
+    }
+}
+
+void stat_ring_destroy(StatRing *r)
+{
+    if (!r)
+        return;
+
+    if (r->free_slots)
+    {
+        stat_ring_drain(r);
+    }
+    if (r->sqes)
+        munmap(r->sqes, r->sqes_size);
+    if (r->cq_ptr && r->cq_ptr != r->sq_ptr)
+        munmap(r->cq_ptr, r->cq_size);
+    if (r->sq_ptr)
+        munmap(r->sq_ptr, r->sq_size);
+    close(r->fd);
+    free(r->bufs);
+    free(r->users);
+    free(r->ctxs);
+    free(r->free_slots);
+    free(r);
+}
+
+#endif /* STAT_RING_IMPLEMENTATION */
+#endif /* STAT_RING_H */
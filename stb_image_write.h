@@ -31,6 +31,12 @@ BUILDING:
    unsigned char * my_compress(unsigned char *data, int data_len, int *out_len, int quality);
    The returned data will be freed with STBIW_FREE() (free() by default),
    so it must be heap allocated with STBIW_MALLOC() (malloc() by default),
+   You can #define STBIW_PNG_FILTER to filter the PNG scanlines yourself, with
+   the following signature:
+   int my_filter(const unsigned char *pixels, int stride_bytes, int x, int y, int n, unsigned char *filt);
+   It fills filt with y rows of a filter type byte and x*n filtered bytes and
+   returns nonzero, or returns 0 to leave it to the builtin filters. It is not
+   used with stbi_write_force_png_filter or when flipping vertically.
 
 UNICODE:
 
@@ -1143,7 +1149,12 @@ STBIWDEF unsigned char *stbi_write_png_to_mem(const unsigned char *pixels, int s
 
    filt = (unsigned char *) STBIW_MALLOC((x*n+1) * y); if (!filt) return 0;
    line_buffer = (signed char *) STBIW_MALLOC(x * n); if (!line_buffer) { STBIW_FREE(filt); return 0; }
-   for (j=0; j < y; ++j) {
+   j = 0;
+#ifdef STBIW_PNG_FILTER
+   if (force_filter < 0 && !stbi__flip_vertically_on_write && STBIW_PNG_FILTER(pixels, stride_bytes, x, y, n, filt))
+      j = y;
+#endif
+   for (; j < y; ++j) {
       int filter_type;
       if (force_filter > -1) {
          filter_type = force_filter;
@@ -1,13 +1,91 @@
+#ifdef _WIN32
 #include <windows.h>
+// pool.h is POSIX only, everything runs serially without a pool
+typedef struct Pool Pool;
+static Pool *pool_create(int threads)
+{
+    (void)threads;
+    return NULL;
+}
+static void pool_destroy(Pool *p)
+{
+    (void)p;
+}
+#else
+#define _DEFAULT_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <stdatomic.h>
+#define POOL_IMPLEMENTATION
+#include "pool.h"
+#define STAT_RING_IMPLEMENTATION
+#include "stat_ring.h"
+#endif
 #include <stdio.h>
 #include <stdbool.h>
-#include <ctype.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+
+#define CHECKSUM_IMPLEMENTATION
+#include "checksum.h"
+// PNG chunk CRCs in stbi_write_png() too
+#define STBIW_CRC32(buf, len) crc32_update(0, buf, (size_t)(len))
+#define DEFLATE_IMPLEMENTATION
+#include "deflate.h"
+#ifndef _WIN32
+// png_stream and stbi_write_png() deflate on the pool
+#define PZLIB_IMPLEMENTATION
+#include "pzlib.h"
+#define STBIW_ZLIB_COMPRESS pzlib_compress
+#endif
+#define PNG_FILTER_IMPLEMENTATION
+#include "png_filter.h"
+
+// stbi_write_png() filters its rows with png_filter.h as well
+static PngFilterMode stbiw_filter_mode = PNG_FILTER_ADAPTIVE;
+
+static int stbiw_filter_rows(const unsigned char *pixels, int stride, int w, int h, int n, unsigned char *filt)
+{
+    size_t len = (size_t)w * n;
+    unsigned char *scratch = (unsigned char *)malloc(3 * (len + 1));
+    if (!scratch)
+        return 0;
+    unsigned char *bufs[2] = {scratch, scratch + len + 1};
+    unsigned char *zeros = scratch + 2 * (len + 1);
+    memset(zeros, 0, len);
+
+    for (int y = 0; y < h; y++)
+    {
+        const unsigned char *row = pixels + (size_t)stride * y;
+        const unsigned char *up = y > 0 ? row - stride : zeros;
+        memcpy(filt + (len + 1) * y, png_filter_row(row, up, len, n, stbiw_filter_mode, bufs), len + 1);
+    }
+    free(scratch);
+    return 1;
+}
+#define STBIW_PNG_FILTER stbiw_filter_rows
 
 #define IMG_UTIL_IMPLEMENTATION
 #include "img_util.h"
-
-#define IMG_WIDTH 1024
-#define IMG_HEIGHT 1024
+#define ARENA_IMPLEMENTATION
+#include "arena.h"
+#define PNG_STREAM_IMPLEMENTATION
+#include "png_stream.h"
+
+// the canvas is sized to the tree, up to this unless told otherwise
+#define MAX_IMG_WIDTH 16384
+#define MAX_IMG_HEIGHT 16384
+#define IMG_MARGIN 10
+#define DEFAULT_MAX_LABEL 32 // glyphs, longer names end in LABEL_ELLIPSIS
+#define LABEL_ELLIPSIS "..."
+#define LABEL_ELLIPSIS_LEN 3
+#define COLOR_AGGREGATE COLOR_LIGHTGRAY // stands in for a subtree too small to draw
 
 typedef enum
 {
@@ -18,60 +96,176 @@ typedef enum
 typedef struct Node Node;
 struct Node
 {
-    char name[512];
+    const char *name;
     Node *child;
+    Node *last_child; // append point for add_child()
     Node *sibling;
     NODE_TYPE type;
     int child_cnt;
-    int children_name_len;
+    unsigned short name_len;    // bytes, names are cut at 511
+    unsigned short name_glyphs; // cells it takes when drawn
+    long long size;  // only filled when scanning with stat
+    long long mtime; // seconds since the epoch
 };
 
-typedef struct DrawNode DrawNode;
-struct DrawNode
+// Owns every node of one tree and their interned names, freed in one go
+typedef struct
 {
-    char name[512];
-    int child_cnt;
-    DrawNode *child;
-    DrawNode *sibling;
-    NODE_TYPE type;
+    Arena arena;
+    StrPool names;
+} NodeArena;
 
-    int draw_x;
-    int draw_y;
-    int draw_width;
-    int draw_heigth;
-    unsigned int color;
-    bool has_gap;
-    bool is_first_child;
-    int next_level_needed_width;
+// Flat copy of a Node tree in pre-order with one array per field. A node's
+// subtree is the index range [i, subtree_end[i]) and parents always come
+// before their children, so every pass is a forward or backward array scan.
+#define NO_NODE UINT32_MAX
+
+enum
+{
+    NODE_LAID = 1 << 0, // placed by the layout pass, culled otherwise
+    NODE_HAS_GAP = 1 << 1,
+    NODE_FIRST_CHILD = 1 << 2,
 };
 
+// Uniform grid over the bounds of the laid nodes, built by layout_tree().
+// A parent's bounds take in the arrow under it, the one edge drawn, so a
+// rectangle query finds every node and edge that touches it. Cell k lists
+// ids[start[k] .. start[k + 1]) in store order.
+typedef struct
+{
+    int cell; // side of the square cells
+    int cols;
+    int rows;
+    uint32_t *start;
+    uint32_t *ids;
+} NodeGrid;
+
+// Result of node_grid_query(), grows as needed
+typedef struct
+{
+    uint32_t *ids;
+    size_t cnt;
+    size_t cap;
+} NodeHits;
+
+typedef struct
+{
+    uint32_t cnt;
+
+    uint32_t *parent;
+    uint32_t *first_child;
+    uint32_t *last_child;
+    uint32_t *next_sibling;
+    uint32_t *subtree_end;
+    uint32_t *name_off; // into names
+    uint8_t *type;
+    int *depth;
+    int *child_cnt;
+    int *children_name_len; // sum of label_len over the children
+    uint32_t *children;     // children of i, in order, from child_start[i]
+    uint32_t *child_start;
+    uint32_t *files; // in the subtree, the node itself included
+    uint32_t *dirs;
+    long long *size;
+    long long *mtime;
+
+    char *names; // every name, NUL separated
+    int *label_len;        // glyphs drawn for the name, ellipsis included
+    uint16_t *label_bytes; // of the name drawn before the ellipsis, if cut
+
+    // layout
+    int *draw_x;
+    int *draw_y;
+    int *draw_width;
+    int *draw_height;
+    unsigned int *color;
+    int *child_gap; // between the children of this node
+    uint8_t *flags;
+    int *span_x0; // bounds of the whole subtree, see measure_subtrees()
+    int *span_x1;
+    int *span_y1;
+    int *reach_x0; // least span_x0 of this and the later siblings
+    int *reach_x1; // greatest span_x1 of this and the earlier siblings
+
+    // tidy layout scratch, see prepare_drawing_tree()
+    uint32_t *prev_sibling;
+    uint32_t *thread; // next node on a contour, for nodes without children
+    uint32_t *ancestor;
+    int *number; // position among its siblings
+    int *prelim; // centre x relative to the parent's subtree
+    int *mod;    // moves every descendant by this much
+    int *shift;
+    int *change;
+
+    NodeGrid grid;
+} TreeStore;
+
 typedef struct
 {
-    DrawNode *node;
-    int max_width_needed;
+    int max_width_needed;  // measured size of the whole tree
     int max_height_needed;
+    int max_canvas_width; // cap on the canvas, the rest is cut off
+    int max_canvas_height;
+    int canvas_width; // what gets rendered: the measured size within the cap
+    int canvas_height;
     int parent_cnt;
     int scale;
     int internal_padd;
     int arrow_length;
-    int gap;
+    int gap;         // between siblings, unless their row would not fit
+    int narrowed;    // parents whose children got a smaller gap
+    Pool *pool;      // for the layout and drawing, NULL does them serially
+    int channels;    // of the canvas: 3 RGB, 1 palette index
+    Palette palette; // every colour the tree is drawn with, white first
 } TreeData;
 
+// Part of the laid-out tree to render: the rectangle [x, x + w) x [y, y + h)
+// in layout pixels, drawn zoom times bigger or shrink times smaller. With a
+// root only that node's subtree is drawn.
+typedef struct
+{
+    int x;
+    int y;
+    int w;
+    int h;
+    int zoom;
+    int shrink;
+    uint32_t root; // NO_NODE for the whole tree
+    int lod;       // subtrees narrower than this many output pixels are aggregated, 0 never
+} View;
+
+typedef struct
+{
+    bool sorted;    // order children by name instead of readdir order
+    bool stat;      // fill size and mtime of every node
+    bool use_uring; // batch those stats through io_uring when available
+} ScanOptions;
+
+#ifdef _WIN32
+#define PATH_SEP '\\'
+#else
+#define PATH_SEP '/'
+#endif
+
 const char *basename(const char *path)
 {
-    const char *p = strrchr(path, '\\');
+    const char *p = strrchr(path, PATH_SEP);
     return p ? p + 1 : path;
 }
 
-void to_uppercase(char *s)
+void node_arena_init(NodeArena *mem)
 {
-    for (; *s; s++)
-    {
-        *s = (char)toupper((unsigned char)*s);
-    }
+    arena_init(&mem->arena);
+    strpool_init(&mem->names, &mem->arena);
+}
+
+void node_arena_free(NodeArena *mem)
+{
+    strpool_free(&mem->names);
+    arena_free(&mem->arena);
 }
 
-Node *new_node(char *name, NODE_TYPE type)
+Node *new_node(NodeArena *mem, const char *name, NODE_TYPE type)
 {
     if (name == NULL)
     {
@@ -79,19 +273,26 @@ Node *new_node(char *name, NODE_TYPE type)
         return NULL;
     }
 
-    Node *new = (Node *)malloc(sizeof(Node));
+    Node *new = (Node *)arena_alloc(&mem->arena, sizeof(Node));
     if (!new)
     {
-        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
         return NULL;
     }
 
-    strncpy(new->name, name, sizeof(new->name) - 1);
-    new->name[sizeof(new->name) - 1] = '\0';
+    size_t len = strnlen(name, 511);
+    new->name = strpool_intern(&mem->names, name, len);
+    if (!new->name)
+    {
+        return NULL;
+    }
+    new->name_len = (unsigned short)len;
+    new->name_glyphs = (unsigned short)text_glyph_count(new->name);
     new->child = NULL;
+    new->last_child = NULL;
     new->sibling = NULL;
     new->child_cnt = 0;
-    new->children_name_len = 0;
+    new->size = 0;
+    new->mtime = 0;
     new->type = type;
     return new;
 }
@@ -107,99 +308,57 @@ void add_child(Node *parent, Node *child)
     }
     else
     {
-        Node *cur = parent->child;
-        while (cur->sibling)
-        {
-            cur = cur->sibling;
-        }
-        cur->sibling = child;
+        parent->last_child->sibling = child;
     }
+    parent->last_child = child;
 
     parent->child_cnt++;
-    parent->children_name_len += strlen(child->name);
 }
 
-void free_node(Node *n)
+static int cmp_node_name(const void *a, const void *b)
 {
-    if (!n)
-        return;
-
-    free_node(n->child);
-    free_node(n->sibling);
-    free(n);
+    return strcmp((*(Node *const *)a)->name, (*(Node *const *)b)->name);
 }
 
-DrawNode *new_draw_node(char *name, NODE_TYPE type)
+// Reorder the children of parent by name so scans are reproducible
+void sort_children(Node *parent)
 {
-    if (name == NULL)
-    {
-        fprintf(stderr, "ERROR: DrawNode NOT PROVIDED");
-        return NULL;
-    }
+    if (!parent || parent->child_cnt < 2)
+        return;
 
-    DrawNode *new = (DrawNode *)malloc(sizeof(DrawNode));
-    if (!new)
+    Node **list = (Node **)malloc(sizeof(Node *) * parent->child_cnt);
+    if (!list)
     {
         fprintf(stderr, "ERROR: OUT OF MEMORY\n");
-        return NULL;
-    }
-
-    strncpy(new->name, name, sizeof(new->name) - 1);
-    new->name[sizeof(new->name) - 1] = '\0';
-    to_uppercase(new->name);
-    new->child = NULL;
-    new->sibling = NULL;
-    new->type = type;
-    new->draw_x = 0;
-    new->draw_y = 0;
-    new->draw_width = 0;
-    new->draw_heigth = 0;
-    new->color = 0;
-    new->child_cnt = 0;
-    new->has_gap = false;
-    new->is_first_child = false;
-    new->next_level_needed_width = 0;
-    return new;
-}
-
-void add_draw_child(DrawNode *parent, DrawNode *child)
-{
-    if (!parent || !child)
         return;
+    }
 
-    if (!parent->child)
+    int n = 0;
+    for (Node *cur = parent->child; cur; cur = cur->sibling)
     {
-        parent->child = child;
+        list[n++] = cur;
     }
-    else
+    qsort(list, n, sizeof(Node *), cmp_node_name);
+
+    for (int i = 0; i < n - 1; i++)
     {
-        DrawNode *cur = parent->child;
-        while (cur->sibling)
-        {
-            cur = cur->sibling;
-        }
-        cur->sibling = child;
+        list[i]->sibling = list[i + 1];
     }
+    list[n - 1]->sibling = NULL;
+    parent->child = list[0];
+    parent->last_child = list[n - 1];
+    free(list);
 }
 
-void free_draw_tree(DrawNode *n)
-{
-    if (!n)
-        return;
-
-    free_draw_tree(n->child);
-    free_draw_tree(n->sibling);
-    free(n);
-}
-
-void tranverse(const char *start_path, Node *root)
+#ifdef _WIN32
+// Adds every entry of path as a child of root
+static void list_dir(NodeArena *mem, const char *path, Node *root)
 {
     WIN32_FIND_DATA d;
     HANDLE h;
 
     char search[512];
-    char next[512];
-    snprintf(search, sizeof(search), "%s\\*", start_path);
+    snprintf(search, sizeof(search), "%s\\*", path);
 
     h = FindFirstFile(search, &d);
     if (h == INVALID_HANDLE_VALUE)
@@ -219,16 +378,13 @@ void tranverse(const char *start_path, Node *root)
         // Create new parent
         if (d.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
         {
-
-            if (strcmp(d.cFileName, ".") != 0 &&
-                strcmp(d.cFileName, "..") != 0)
+            Node *child = new_node(mem, d.cFileName, PARENT);
+            if (!child)
             {
-                snprintf(next, sizeof(next), "%s\\%s", start_path, d.cFileName);
-                Node *new_root = new_node(d.cFileName, PARENT);
-                add_child(root, new_root);
-                tranverse(next, new_root);
-                SetCurrentDirectory("..");
+                fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+                break;
             }
+            add_child(root, child);
         }
         else
         {
@@ -236,7 +392,18 @@ void tranverse(const char *start_path, Node *root)
             char new_child[512];
             strncpy(new_child, d.cFileName, sizeof(new_child) - 1);
             new_child[sizeof(new_child) - 1] = '\0';
-            Node *child = new_node(new_child, CHILD);
+            Node *child = new_node(mem, new_child, CHILD);
+            if (!child)
+            {
+                fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+                break;
+            }
+            // FindFirstFile already reports these, no extra call needed
+            child->size = ((long long)d.nFileSizeHigh << 32) | d.nFileSizeLow;
+            child->mtime = ((((long long)d.ftLastWriteTime.dwHighDateTime << 32) |
+                             d.ftLastWriteTime.dwLowDateTime) -
+                            116444736000000000LL) /
+                           10000000LL;
             add_child(root, child);
         }
     } while (FindNextFile(h, &d));
@@ -244,324 +411,2519 @@ void tranverse(const char *start_path, Node *root)
     FindClose(h);
 }
 
-// Show tree in terminal
-void walk(Node *n, int lvl, bool addr)
+typedef struct
 {
-    if (!n)
+    char path[512];
+    Node *node;
+} ScanFrame;
+
+// Directories still to list are kept on a heap stack, not the call stack.
+// FindFirstFile already returns NTFS entries sorted and with their size
+// and mtime, so opts change nothing here.
+void tranverse(NodeArena *mem, const char *start_path, Node *root, ScanOptions opts)
+{
+    (void)opts;
+    size_t cap = 64, len = 0;
+    ScanFrame *stack = (ScanFrame *)malloc(sizeof(ScanFrame) * cap);
+    if (!stack)
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
         return;
-    int pad = 5 * lvl;
-    printf("%*s", pad, "");
-    if (n->type == PARENT)
+    }
+
+    snprintf(stack[0].path, sizeof(stack[0].path), "%s", start_path);
+    stack[0].node = root;
+    len = 1;
+
+    while (len > 0)
     {
-        if (addr)
-        {
-            printf("[P]%s(%p) -> (%p, %p)\n", n->name, n, n->child, n->sibling);
-        }
-        else
+        ScanFrame f = stack[--len];
+        list_dir(mem, f.path, f.node);
+
+        for (Node *cur = f.node->child; cur; cur = cur->sibling)
         {
-            printf("[P]%s\n", n->name);
+            if (cur->type != PARENT)
+            {
+                continue;
+            }
+
+            if (len == cap)
+            {
+                ScanFrame *grown = (ScanFrame *)realloc(stack, sizeof(ScanFrame) * cap * 2);
+                if (!grown)
+                {
+                    fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+                    free(stack);
+                    return;
+                }
+                stack = grown;
+                cap *= 2;
+            }
+            snprintf(stack[len].path, sizeof(stack[len].path), "%s\\%s", f.path, cur->name);
+            stack[len].node = cur;
+            len++;
         }
     }
-    else
+
+    free(stack);
+}
+
+// No pool on Windows yet
+void tranverse_parallel(NodeArena *mem, const char *start_path, Node *root, ScanOptions opts, Pool *pool)
+{
+    (void)pool;
+    tranverse(mem, start_path, root, opts);
+}
+#else
+// getdents64 records, the kernel does not export this struct
+struct linux_dirent64
+{
+    unsigned long long d_ino;
+    long long d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+#define DIRENT_BUF_SIZE (1 << 20)
+
+static bool is_dir_entry(int dirfd, struct linux_dirent64 *d)
+{
+    if (d->d_type != DT_UNKNOWN)
     {
-        if (addr)
-        {
-            printf("%s%s(%p) -> (%p, %p)\n", "[C]", n->name, n, n->child, n->sibling);
-        }
-        else
-        {
-            printf("%s%s\n", "[C]", n->name);
-        }
+        return d->d_type == DT_DIR;
     }
 
-    walk(n->child, lvl + 1, addr);
-    walk(n->sibling, lvl, addr);
+    // some filesystems do not fill d_type, only then pay for a stat
+    struct stat st;
+    if (fstatat(dirfd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+    {
+        return false;
+    }
+    return S_ISDIR(st.st_mode);
 }
 
-void walk_draw(DrawNode *n, int lvl, bool addr)
+// Adds every entry of dirfd as a child of root
+static void read_dir(NodeArena *mem, int dirfd, Node *root, char *buf)
 {
-    if (!n)
-        return;
-    int pad = 5 * lvl;
-    printf("%*s", pad, "");
-    if (n->type == PARENT)
+    long n;
+    while ((n = syscall(SYS_getdents64, dirfd, buf, DIRENT_BUF_SIZE)) > 0)
     {
-        if (addr)
-        {
-            printf("[P]%s(%p) -> (%p, %p)\n", n->name, n, n->child, n->sibling);
-        }
-        else
+        for (long off = 0; off < n;)
         {
-            printf("[P]%s\n", n->name);
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + off);
+            off += d->d_reclen;
+
+            // skip . files
+            if (d->d_name[0] == '.')
+            {
+                continue;
+            }
+
+            NODE_TYPE type = is_dir_entry(dirfd, d) ? PARENT : CHILD;
+            Node *child = new_node(mem, d->d_name, type);
+            if (!child)
+            {
+                fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+                return;
+            }
+            add_child(root, child);
         }
     }
-    else
+    if (n < 0)
     {
-        if (addr)
-        {
-            printf("%s%s(%p) -> (%p, %p)\n", "[C]", n->name, n, n->child, n->sibling);
-        }
-        else
-        {
-            printf("%s%s\n", "[C]", n->name);
-        }
+        fprintf(stderr, "ERROR: FAILED TO READ DIRECTORY %s\n", root->name);
     }
-
-    walk_draw(n->child, lvl + 1, addr);
-    walk_draw(n->sibling, lvl, addr);
 }
 
-void walk_draw_verbose(DrawNode *n, int lvl, bool addr)
+static void stat_node(int dirfd, Node *n)
 {
-    if (!n)
+    struct stat st;
+    if (fstatat(dirfd, n->name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+    {
+        fprintf(stderr, "ERROR: FAILED TO STAT %s\n", n->name);
         return;
+    }
+    n->size = (long long)st.st_size;
+    n->mtime = (long long)st.st_mtime;
+}
 
-    int pad = 4 * lvl;
-    printf("%*s", pad, "");
-
-    /* header do nó */
-    printf("[%s] name=\"%s\"",
-           (n->type == PARENT) ? "P" : "C",
-           n->name);
-
-    if (addr)
+// --sort and --stat for a directory the serial scan just read
+static void finish_dir(int dirfd, Node *node, ScanOptions opts)
+{
+    if (opts.sorted)
+    {
+        sort_children(node);
+    }
+    for (Node *cur = node->child; opts.stat && cur; cur = cur->sibling)
     {
-        printf(" @%p", (void *)n);
+        stat_node(dirfd, cur);
     }
-    printf("\n");
+}
 
-    /* campos internos */
-    printf("%*s  child_cnt        = %d\n", pad, "", n->child_cnt);
-    printf("%*s  type             = %d\n", pad, "", n->type);
+typedef struct
+{
+    int fd;
+    Node *next; // next child to look at for subdirectories
+} ScanFrame;
+
+// Reads every entry of a directory into its node before descending, so one
+// buffer is enough for the whole walk and only one fd per level stays open.
+// The open levels live on a heap stack, not the call stack.
+static void tranverse_fd(NodeArena *mem, int dirfd, Node *root, char *buf, ScanOptions opts)
+{
+    size_t cap = 64, len = 0;
+    ScanFrame *stack = (ScanFrame *)malloc(sizeof(ScanFrame) * cap);
+    if (!stack)
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+        return;
+    }
 
-    printf("%*s  draw_x           = %d\n", pad, "", n->draw_x);
-    printf("%*s  draw_y           = %d\n", pad, "", n->draw_y);
-    printf("%*s  draw_width       = %d\n", pad, "", n->draw_width);
-    printf("%*s  draw_heigth      = %d\n", pad, "", n->draw_heigth);
-    printf("%*s  has_gap          = %d\n", pad, "", n->has_gap);
-    printf("%*s  is_first_child   = %d\n", pad, "", n->is_first_child);
-    printf("%*s  color            = 0x%06X\n", pad, "", n->color);
+    read_dir(mem, dirfd, root, buf);
+    finish_dir(dirfd, root, opts);
+    stack[len++] = (ScanFrame){dirfd, root->child};
 
-    if (addr)
+    while (len > 0)
     {
-        printf("%*s  child           = %p\n", pad, "", (void *)n->child);
-        printf("%*s  sibling         = %p\n", pad, "", (void *)n->sibling);
-    }
+        ScanFrame *top = &stack[len - 1];
+        Node *cur = top->next;
+        while (cur && cur->type != PARENT)
+        {
+            cur = cur->sibling;
+        }
+
+        if (!cur)
+        {
+            // the caller owns the first fd
+            if (len > 1)
+            {
+                close(top->fd);
+            }
+            len--;
+            continue;
+        }
+        top->next = cur->sibling;
+
+        int fd = openat(top->fd, cur->name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0)
+        {
+            fprintf(stderr, "ERROR: FAILED TO OPEN DIRECTORY %s\n", cur->name);
+            continue;
+        }
+        read_dir(mem, fd, cur, buf);
+        finish_dir(fd, cur, opts);
 
-    printf("\n");
+        if (len == cap)
+        {
+            ScanFrame *grown = (ScanFrame *)realloc(stack, sizeof(ScanFrame) * cap * 2);
+            if (!grown)
+            {
+                fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+                close(fd);
+                continue;
+            }
+            stack = grown;
+            cap *= 2;
+        }
+        stack[len++] = (ScanFrame){fd, cur->child};
+    }
 
-    /* desce na árvore */
-    walk_draw_verbose(n->child, lvl + 1, addr);
-    walk_draw_verbose(n->sibling, lvl, addr);
+    free(stack);
 }
 
-// Prepare data for drawing tree
-void prepare_drawing_tree(
-    Node *source, DrawNode *draw_root, TreeData *tree_data,
-    int draw_x, int draw_y,
-    bool is_first_child)
+void tranverse(NodeArena *mem, const char *start_path, Node *root, ScanOptions opts)
 {
-    if (!source || !tree_data)
+    int fd = open(start_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
     {
+        fprintf(stderr, "ERROR: INVALID HANDLER\n");
         return;
     }
 
-    if (draw_x < 0 || draw_y < 0 || draw_x >= IMG_WIDTH || draw_y >= IMG_HEIGHT)
+    char *buf = malloc(DIRENT_BUF_SIZE);
+    if (!buf)
     {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+        close(fd);
         return;
     }
 
-    int next_level_expected_width = -1;
-    int middle = -1;
-    int start_children = -1;
+    tranverse_fd(mem, fd, root, buf, opts);
 
-    int title_size = (int)strlen(source->name);
-    // -1 -> whitespace on the bitmap
-    int rw = BITMAP_SIZE * title_size * tree_data->scale - 1 + tree_data->internal_padd * 2;
-    int rh = BITMAP_SIZE - 1 + tree_data->internal_padd * 2;
+    free(buf);
+    close(fd);
+}
 
-    DrawNode *new_node = new_draw_node(source->name, source->type);
-    if (new_node->type == PARENT)
-    {
-        // HANDLE ROOT
-        if (draw_x == IMG_WIDTH / 2)
-        {
-            draw_x = draw_x - rw / 2;
-            tree_data->node = new_node;
-        }
+// Parallel scan: every directory is one pool task. A task reads its whole
+// directory into its own Node, so no two tasks ever touch the same child
+// list and the tree comes out with the same shape as tranverse().
+typedef struct
+{
+    int fd;
+    atomic_int refs; // tasks and stats that still have to use fd
+} DirHandle;
 
-        int gap_num = (source->child_cnt > 0) ? (source->child_cnt - 1) : 0;
-        int total_gap = tree_data->gap * gap_num;
-        next_level_expected_width =
-            source->children_name_len * BITMAP_SIZE * tree_data->scale +
-            ((tree_data->internal_padd * 2) * source->child_cnt) - source->child_cnt;
+typedef struct
+{
+    Pool *pool;
+    char **bufs;      // one getdents buffer per slot
+    NodeArena *mems;  // one node arena per slot, merged after the scan
+    StatRing **rings; // one io_uring per slot, NULL entries stat inline
+    ScanOptions opts;
+} ScanJob;
 
-        if (next_level_expected_width + total_gap > IMG_WIDTH)
+typedef struct
+{
+    ScanJob *job;
+    DirHandle *parent;
+    const char *path; // relative to parent->fd
+    Node *node;
+    bool follow; // the start directory, followed if a link like tranverse() does
+} ScanTask;
+
+static void release_dir(DirHandle *h)
+{
+    if (atomic_fetch_sub(&h->refs, 1) == 1)
+    {
+        if (h->fd >= 0)
         {
-            printf("WARNING: Gap exceeded screen width. Resizing.\n");
-            int new_gap = (IMG_WIDTH - next_level_expected_width + source->child_cnt) / gap_num;
-            tree_data->gap = new_gap > 0 ? new_gap : 0;
+            close(h->fd);
         }
+        free(h);
+    }
+}
 
-        middle = draw_x + rw / 2;
-        start_children = middle - next_level_expected_width / 2; // - tree_data->gap * gap_num
-        tree_data->parent_cnt = tree_data->parent_cnt + 1;
-
-        new_node->next_level_needed_width = next_level_expected_width;
-        new_node->color = COLOR_RED;
+static void stat_done(void *user, void *ctx, const struct statx *st, int err)
+{
+    Node *n = (Node *)user;
+    if (st)
+    {
+        n->size = (long long)st->stx_size;
+        n->mtime = (long long)st->stx_mtime.tv_sec;
     }
     else
     {
-        new_node->color = COLOR_YELLOW;
+        fprintf(stderr, "ERROR: FAILED TO STAT %s (%s)\n", n->name, strerror(err));
     }
+    release_dir((DirHandle *)ctx);
+}
 
-    new_node->draw_x = draw_x;
-    new_node->draw_y = draw_y;
-    new_node->draw_width = rw;
-    new_node->draw_heigth = rh;
-    new_node->child_cnt = source->child_cnt;
-    new_node->is_first_child = is_first_child;
+// A slot per worker, and a last one for the thread that called
+// tranverse_parallel(): pool_submit() runs a task there when it cannot
+// queue it
+static int scan_slot(ScanJob *job)
+{
+    int id = pool_worker_id(job->pool);
+    return id >= 0 ? id : pool_size(job->pool);
+}
 
-    if (source->sibling != NULL)
+static void stat_entry(ScanJob *job, DirHandle *h, Node *n)
+{
+    StatRing *ring = job->rings ? job->rings[scan_slot(job)] : NULL;
+    if (ring)
     {
-        new_node->has_gap = true;
+        // the request keeps the directory open until it completes, which
+        // scan_task() waits for before it returns
+        atomic_fetch_add(&h->refs, 1);
+        stat_ring_submit(ring, h->fd, n->name, n, h);
+        return;
     }
 
-    add_draw_child(draw_root, new_node);
+    stat_node(h->fd, n);
+}
 
-    prepare_drawing_tree(
-        source->child, new_node, tree_data,
-        start_children, draw_y + rh + tree_data->arrow_length + 40,
-        true);
+#define SCAN_OPEN_RETRIES 1000
 
-    int next_sibling_pos = draw_x + rw; // + tree_data->gap
-    prepare_drawing_tree(
-        source->sibling, draw_root, tree_data,
-        next_sibling_pos, draw_y,
-        false);
+// openat() that waits out a full fd table: the other workers close their
+// directories as they finish them
+static int open_dir(int dirfd, const char *path, int flags)
+{
+    for (int tries = 0;; tries++)
+    {
+        int fd = openat(dirfd, path, flags);
+        if (fd >= 0 || (errno != EMFILE && errno != ENFILE) || tries == SCAN_OPEN_RETRIES)
+        {
+            return fd;
+        }
+        struct timespec pause = {0, 1000000};
+        nanosleep(&pause, NULL);
+    }
 }
 
-void draw_tree(
-    unsigned char *img, DrawNode *d, TreeData tree_data,
-    int x, int y // comes from parent
-)
+static void scan_task(void *arg)
 {
-    if (!img || !d)
+    ScanTask *t = (ScanTask *)arg;
+    ScanJob *job = t->job;
+    Node *node = t->node;
+
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC | (t->follow ? 0 : O_NOFOLLOW);
+    int fd = open_dir(t->parent->fd, t->path, flags);
+    int err = errno;
+    release_dir(t->parent);
+    free(t);
+    if (fd < 0)
     {
+        fprintf(stderr, "ERROR: FAILED TO OPEN DIRECTORY %s (%s)\n", node->name, strerror(err));
         return;
     }
 
-    int start_children = 0;
+    int slot = scan_slot(job);
+    read_dir(&job->mems[slot], fd, node, job->bufs[slot]);
+    if (job->opts.sorted)
+    {
+        sort_children(node);
+    }
 
-    fill_rect(img, IMG_WIDTH, x, d->draw_y, d->draw_width, d->draw_heigth, d->color);
-    draw_text_scale(img, IMG_WIDTH, x + tree_data.internal_padd, d->draw_y + tree_data.internal_padd, d->name, tree_data.scale);
-    if (d->type == PARENT)
+    DirHandle *h = (DirHandle *)malloc(sizeof(DirHandle));
+    if (!h)
     {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+        close(fd);
+        return;
+    }
+    h->fd = fd;
+    atomic_init(&h->refs, 1); // this task
 
-        draw_arrow(
-            img, IMG_WIDTH,
-            x + d->draw_width / 2, d->draw_y + d->draw_heigth + 2,
-            x + d->draw_width / 2, d->draw_y + d->draw_heigth + tree_data.arrow_length);
+    for (Node *cur = node->child; cur; cur = cur->sibling)
+    {
+        if (job->opts.stat)
+        {
+            stat_entry(job, h, cur);
+        }
+        if (cur->type != PARENT)
+        {
+            continue;
+        }
 
-        int gap_cnt = (d->child_cnt > 0) ? (d->child_cnt - 1) : 0;
-        int middle = x + d->draw_width / 2;
-        start_children = middle - (d->next_level_needed_width + tree_data.gap * (gap_cnt)) / 2;
+        ScanTask *sub = (ScanTask *)malloc(sizeof(ScanTask));
+        if (!sub)
+        {
+            fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+            continue;
+        }
+        sub->job = job;
+        sub->parent = h;
+        sub->path = cur->name;
+        sub->node = cur;
+        sub->follow = false;
+        atomic_fetch_add(&h->refs, 1);
+        pool_submit(job->pool, scan_task, sub);
     }
 
-    draw_tree(
-        img, d->child, tree_data,
-        start_children, y);
-    int next_sibling_pos = x + d->draw_width + tree_data.gap;
-    draw_tree(
-        img, d->sibling, tree_data,
-        next_sibling_pos, y);
+    // queued stats pin their directory's fd, do not let them pile up
+    // across directories until the fd table is full
+    StatRing *ring = job->rings ? job->rings[scan_slot(job)] : NULL;
+    if (ring)
+    {
+        stat_ring_drain(ring);
+    }
+    release_dir(h);
 }
 
-void load_tree(Node *root, TreeData *tree_data, unsigned char *img)
+#define STAT_RING_DEPTH 256
+
+void tranverse_parallel(NodeArena *mem, const char *start_path, Node *root, ScanOptions opts, Pool *pool)
 {
-    if (img == NULL || root == NULL)
+    ScanJob job;
+    job.opts = opts;
+    job.rings = NULL;
+    job.pool = pool;
+    if (!job.pool)
     {
-        fprintf(stderr, "ERROR: NULL PARAMETERS");
+        tranverse(mem, start_path, root, opts);
         return;
     }
 
-    // white background
-    for (int i = 0; i < IMG_WIDTH * IMG_HEIGHT * 3; i++)
+    int slots = pool_size(job.pool) + 1; // see scan_slot()
+    job.bufs = (char **)calloc(slots, sizeof(char *));
+    job.mems = (NodeArena *)malloc(sizeof(NodeArena) * slots);
+    for (int i = 0; job.mems && i < slots; i++)
     {
-        img[i] = 255;
+        node_arena_init(&job.mems[i]);
+    }
+    bool ok = job.bufs != NULL && job.mems != NULL;
+    for (int i = 0; ok && i < slots; i++)
+    {
+        job.bufs[i] = malloc(DIRENT_BUF_SIZE);
+        ok = job.bufs[i] != NULL;
     }
 
-    // INIT TREE DATA
-    tree_data->node = NULL;
-    tree_data->max_width_needed = 0;
-    tree_data->max_height_needed = 0;
-    tree_data->parent_cnt = 0;
-    tree_data->scale = 1;
-    tree_data->internal_padd = 3;
-    tree_data->arrow_length = 20;
-    tree_data->gap = 100;
+    if (ok && opts.stat && opts.use_uring)
+    {
+        job.rings = (StatRing **)calloc(slots, sizeof(StatRing *));
+        for (int i = 0; job.rings && i < slots; i++)
+        {
+            job.rings[i] = stat_ring_create(STAT_RING_DEPTH, stat_done);
+            if (!job.rings[i])
+            {
+                // io_uring is all or nothing, stat on the pool instead
+                printf("WARNING: io_uring not available, using blocking stat.\n");
+                for (int k = 0; k < i; k++)
+                {
+                    stat_ring_destroy(job.rings[k]);
+                }
+                free(job.rings);
+                job.rings = NULL;
+            }
+        }
+    }
 
-    prepare_drawing_tree(root, NULL, tree_data, IMG_WIDTH / 2, 0, false);
-    printf("gap: %d\n", tree_data->gap);
-    tree_data->max_height_needed =
-        tree_data->parent_cnt * BITMAP_SIZE * tree_data->scale + ((tree_data->internal_padd * 2) * tree_data->parent_cnt) - tree_data->parent_cnt + tree_data->gap * (tree_data->parent_cnt - 1);
+    ScanTask *t = ok ? (ScanTask *)malloc(sizeof(ScanTask)) : NULL;
+    DirHandle *cwd = t ? (DirHandle *)malloc(sizeof(DirHandle)) : NULL;
+    bool scanned = cwd != NULL;
+    if (scanned)
+    {
+        cwd->fd = AT_FDCWD;
+        atomic_init(&cwd->refs, 1);
+        t->job = &job;
+        t->parent = cwd;
+        t->path = start_path;
+        t->node = root;
+        t->follow = true;
+        pool_submit(job.pool, scan_task, t);
+        pool_wait(job.pool);
+    }
+    else
+    {
+        free(t);
+    }
 
-    //  resize arrow acording to gap
-    draw_tree(img, tree_data->node, *tree_data, tree_data->node->draw_x, tree_data->node->draw_y);
-}
+    // workers are idle now, collect the stats still in flight
+    for (int i = 0; job.rings && i < slots; i++)
+    {
+        stat_ring_destroy(job.rings[i]);
+    }
+    free(job.rings);
 
-int main()
-{
-    const char *start_file = "C:\\Users\\marco\\Programming\\DirectoryTree";
+    for (int i = 0; job.bufs && i < slots; i++)
+    {
+        free(job.bufs[i]);
+    }
+    free(job.bufs);
 
-    Node *root = NULL;
-    TreeData *tree_data = (TreeData *)malloc(sizeof(TreeData));
-    if (tree_data == NULL)
+    // the tree outlives the workers, hand their nodes to the caller
+    for (int i = 0; job.mems && i < slots; i++)
     {
-        fprintf(stderr, "ERRROR: NOT ENOUGHT MEMORY FOR TreeData");
-        return 1;
+        strpool_free(&job.mems[i].names);
+        arena_merge(&mem->arena, &job.mems[i].arena);
     }
+    free(job.mems);
 
-    // save first parent
-    if (root == NULL)
+    if (!scanned)
+    {
+        // no memory for the workers' buffers, one buffer may still do
+        printf("WARNING: Out of memory for the parallel scan, scanning serially.\n");
+        tranverse(mem, start_path, root, opts);
+    }
+}
+#endif
+
+void tree_store_free(TreeStore *t)
+{
+    if (!t)
+        return;
+
+    free(t->parent);
+    free(t->first_child);
+    free(t->last_child);
+    free(t->next_sibling);
+    free(t->subtree_end);
+    free(t->name_off);
+    free(t->type);
+    free(t->depth);
+    free(t->child_cnt);
+    free(t->children_name_len);
+    free(t->children);
+    free(t->child_start);
+    free(t->files);
+    free(t->dirs);
+    free(t->size);
+    free(t->mtime);
+    free(t->names);
+    free(t->label_len);
+    free(t->label_bytes);
+    free(t->draw_x);
+    free(t->draw_y);
+    free(t->draw_width);
+    free(t->draw_height);
+    free(t->color);
+    free(t->child_gap);
+    free(t->flags);
+    free(t->span_x0);
+    free(t->span_x1);
+    free(t->span_y1);
+    free(t->reach_x0);
+    free(t->reach_x1);
+    free(t->prev_sibling);
+    free(t->thread);
+    free(t->ancestor);
+    free(t->number);
+    free(t->prelim);
+    free(t->mod);
+    free(t->shift);
+    free(t->change);
+    free(t->grid.start);
+    free(t->grid.ids);
+    free(t);
+}
+
+typedef struct
+{
+    Node *node;
+    uint32_t parent;
+} StoreFrame;
+
+// Pre-order walk of the Node tree: a node, then its children, then its
+// next sibling. visit() gets every node once, in the order of the store.
+static bool for_each_preorder(Node *root, void (*visit)(void *ctx, Node *n, uint32_t parent), void *ctx)
+{
+    size_t cap = 64, len = 0;
+    StoreFrame *stack = (StoreFrame *)malloc(sizeof(StoreFrame) * cap);
+    if (!stack)
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+        return false;
+    }
+
+    // the root's siblings are not part of the tree
+    stack[len++] = (StoreFrame){root, NO_NODE};
+    uint32_t idx = 0;
+    while (len > 0)
+    {
+        StoreFrame f = stack[--len];
+        visit(ctx, f.node, f.parent);
+
+        if (len + 2 > cap)
+        {
+            cap *= 2;
+            StoreFrame *grown = (StoreFrame *)realloc(stack, sizeof(StoreFrame) * cap);
+            if (!grown)
+            {
+                fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+                free(stack);
+                return false;
+            }
+            stack = grown;
+        }
+        if (f.node->sibling && f.node != root)
+        {
+            stack[len++] = (StoreFrame){f.node->sibling, f.parent};
+        }
+        if (f.node->child)
+        {
+            stack[len++] = (StoreFrame){f.node->child, idx};
+        }
+        idx++;
+    }
+
+    free(stack);
+    return true;
+}
+
+typedef struct
+{
+    uint32_t cnt;
+    size_t names_len;
+} StoreCount;
+
+static void count_node(void *ctx, Node *n, uint32_t parent)
+{
+    (void)parent;
+    StoreCount *c = (StoreCount *)ctx;
+    c->cnt++;
+    c->names_len += n->name_len + 1;
+}
+
+typedef struct
+{
+    TreeStore *t;
+    size_t names_len;
+    int max_label;
+} StoreFill;
+
+static void store_node(void *ctx, Node *n, uint32_t parent)
+{
+    StoreFill *f = (StoreFill *)ctx;
+    TreeStore *t = f->t;
+    uint32_t i = t->cnt++;
+
+    t->parent[i] = parent;
+    t->first_child[i] = NO_NODE;
+    t->last_child[i] = NO_NODE;
+    t->next_sibling[i] = NO_NODE;
+    t->type[i] = (uint8_t)n->type;
+    t->depth[i] = parent == NO_NODE ? 0 : t->depth[parent] + 1;
+    t->child_cnt[i] = n->child_cnt;
+    t->children_name_len[i] = 0;
+    t->size[i] = n->size;
+    t->mtime[i] = n->mtime;
+
+    size_t len = n->name_len;
+    t->name_off[i] = (uint32_t)f->names_len;
+    memcpy(t->names + f->names_len, n->name, len + 1);
+    f->names_len += len + 1;
+
+    // long names keep their head and end in the ellipsis
+    t->label_len[i] = n->name_glyphs;
+    t->label_bytes[i] = (uint16_t)len;
+    if (f->max_label > 0 && n->name_glyphs > f->max_label)
+    {
+        t->label_len[i] = f->max_label;
+        t->label_bytes[i] = (uint16_t)text_glyph_prefix(n->name, f->max_label - LABEL_ELLIPSIS_LEN);
+    }
+
+    if (parent != NO_NODE)
+    {
+        t->children_name_len[parent] += t->label_len[i];
+        if (t->last_child[parent] == NO_NODE)
+            t->first_child[parent] = i;
+        else
+            t->next_sibling[t->last_child[parent]] = i;
+        t->last_child[parent] = i;
+    }
+}
+
+// Flattens the tree under root; the Node tree can be freed afterwards.
+// Labels longer than max_label glyphs are cut, <= 0 keeps them whole.
+TreeStore *tree_store_build(Node *root, int max_label)
+{
+    if (!root)
+        return NULL;
+
+    StoreCount c = {0, 0};
+    if (!for_each_preorder(root, count_node, &c))
+        return NULL;
+
+    TreeStore *t = (TreeStore *)calloc(1, sizeof(TreeStore));
+    if (!t)
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+        return NULL;
+    }
+
+    size_t n = c.cnt;
+    t->parent = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    t->first_child = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    t->last_child = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    t->next_sibling = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    t->subtree_end = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    t->name_off = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    t->type = (uint8_t *)malloc(n);
+    t->depth = (int *)malloc(sizeof(int) * n);
+    t->child_cnt = (int *)malloc(sizeof(int) * n);
+    t->children_name_len = (int *)malloc(sizeof(int) * n);
+    t->children = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    t->child_start = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    t->files = (uint32_t *)calloc(n, sizeof(uint32_t));
+    t->dirs = (uint32_t *)calloc(n, sizeof(uint32_t));
+    t->size = (long long *)malloc(sizeof(long long) * n);
+    t->mtime = (long long *)malloc(sizeof(long long) * n);
+    t->names = (char *)malloc(c.names_len);
+    t->label_len = (int *)malloc(sizeof(int) * n);
+    t->label_bytes = (uint16_t *)malloc(sizeof(uint16_t) * n);
+    t->draw_x = (int *)calloc(n, sizeof(int));
+    t->draw_y = (int *)calloc(n, sizeof(int));
+    t->draw_width = (int *)calloc(n, sizeof(int));
+    t->draw_height = (int *)calloc(n, sizeof(int));
+    t->color = (unsigned int *)calloc(n, sizeof(unsigned int));
+    t->child_gap = (int *)calloc(n, sizeof(int));
+    t->flags = (uint8_t *)calloc(n, 1);
+    t->span_x0 = (int *)calloc(n, sizeof(int));
+    t->span_x1 = (int *)calloc(n, sizeof(int));
+    t->span_y1 = (int *)calloc(n, sizeof(int));
+    t->reach_x0 = (int *)calloc(n, sizeof(int));
+    t->reach_x1 = (int *)calloc(n, sizeof(int));
+    t->prev_sibling = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    t->thread = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    t->ancestor = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    t->number = (int *)malloc(sizeof(int) * n);
+    t->prelim = (int *)malloc(sizeof(int) * n);
+    t->mod = (int *)malloc(sizeof(int) * n);
+    t->shift = (int *)malloc(sizeof(int) * n);
+    t->change = (int *)malloc(sizeof(int) * n);
+    if (!t->parent || !t->first_child || !t->last_child || !t->next_sibling ||
+        !t->subtree_end || !t->name_off || !t->type || !t->depth ||
+        !t->child_cnt || !t->children_name_len || !t->children || !t->child_start ||
+        !t->files || !t->dirs || !t->size || !t->mtime ||
+        !t->names || !t->label_len || !t->label_bytes || !t->draw_x || !t->draw_y ||
+        !t->draw_width || !t->draw_height || !t->color || !t->child_gap ||
+        !t->flags || !t->span_x0 || !t->span_x1 || !t->span_y1 || !t->reach_x0 ||
+        !t->reach_x1 || !t->prev_sibling || !t->thread || !t->ancestor ||
+        !t->number || !t->prelim || !t->mod || !t->shift || !t->change)
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+        tree_store_free(t);
+        return NULL;
+    }
+
+    StoreFill f = {t, 0, max_label};
+    if (!for_each_preorder(root, store_node, &f))
+    {
+        tree_store_free(t);
+        return NULL;
+    }
+
+    // children sit after their parent, so one backward scan closes every
+    // range and sums the counts of every subtree
+    for (uint32_t i = t->cnt; i-- > 0;)
+    {
+        uint32_t last = t->last_child[i];
+        t->subtree_end[i] = last == NO_NODE ? i + 1 : t->subtree_end[last];
+        if (t->type[i] == PARENT)
+            t->dirs[i]++;
+        else
+            t->files[i]++;
+        uint32_t p = t->parent[i];
+        if (p != NO_NODE)
+        {
+            t->files[p] += t->files[i];
+            t->dirs[p] += t->dirs[i];
+        }
+    }
+
+    uint32_t off = 0;
+    for (uint32_t i = 0; i < t->cnt; i++)
+    {
+        t->child_start[i] = off;
+        for (uint32_t k = t->first_child[i]; k != NO_NODE; k = t->next_sibling[k])
+            t->children[off++] = k;
+    }
+    return t;
+}
+
+// Show tree in terminal
+void walk(TreeStore *t, bool addr)
+{
+    for (uint32_t i = 0; i < t->cnt; i++)
+    {
+        printf("%*s", 5 * t->depth[i], "");
+        const char *tag = t->type[i] == PARENT ? "[P]" : "[C]";
+        if (addr)
+        {
+            printf("%s%s(#%u) -> (#%d, #%d)\n", tag, t->names + t->name_off[i], i,
+                   (int)t->first_child[i], (int)t->next_sibling[i]);
+        }
+        else
+        {
+            printf("%s%s\n", tag, t->names + t->name_off[i]);
+        }
+    }
+}
+
+// Same as walk() but only what the layout placed
+void walk_draw(TreeStore *t, bool addr)
+{
+    for (uint32_t i = 0; i < t->cnt; i++)
+    {
+        if (!(t->flags[i] & NODE_LAID))
+            continue;
+
+        printf("%*s", 5 * t->depth[i], "");
+        const char *tag = t->type[i] == PARENT ? "[P]" : "[C]";
+        if (addr)
+        {
+            printf("%s%s(#%u) -> (#%d, #%d)\n", tag, t->names + t->name_off[i], i,
+                   (int)t->first_child[i], (int)t->next_sibling[i]);
+        }
+        else
+        {
+            printf("%s%s\n", tag, t->names + t->name_off[i]);
+        }
+    }
+}
+
+void walk_draw_verbose(TreeStore *t, bool addr)
+{
+    for (uint32_t i = 0; i < t->cnt; i++)
+    {
+        if (!(t->flags[i] & NODE_LAID))
+            continue;
+
+        int pad = 4 * t->depth[i];
+        printf("%*s", pad, "");
+
+        /* header do nó */
+        printf("[%s] name=\"%s\"",
+               (t->type[i] == PARENT) ? "P" : "C",
+               t->names + t->name_off[i]);
+
+        if (addr)
+        {
+            printf(" #%u", i);
+        }
+        printf("\n");
+
+        /* campos internos */
+        printf("%*s  child_cnt        = %d\n", pad, "", t->child_cnt[i]);
+        printf("%*s  type             = %d\n", pad, "", t->type[i]);
+
+        printf("%*s  draw_x           = %d\n", pad, "", t->draw_x[i]);
+        printf("%*s  draw_y           = %d\n", pad, "", t->draw_y[i]);
+        printf("%*s  draw_width       = %d\n", pad, "", t->draw_width[i]);
+        printf("%*s  draw_heigth      = %d\n", pad, "", t->draw_height[i]);
+        printf("%*s  has_gap          = %d\n", pad, "", (t->flags[i] & NODE_HAS_GAP) != 0);
+        printf("%*s  child_gap        = %d\n", pad, "", t->child_gap[i]);
+        printf("%*s  is_first_child   = %d\n", pad, "", (t->flags[i] & NODE_FIRST_CHILD) != 0);
+        printf("%*s  color            = 0x%06X\n", pad, "", t->color[i]);
+
+        if (addr)
+        {
+            printf("%*s  child           = #%d\n", pad, "", (int)t->first_child[i]);
+            printf("%*s  sibling         = #%d\n", pad, "", (int)t->next_sibling[i]);
+        }
+
+        printf("\n");
+    }
+}
+
+// Distance between the centres of two neighbours on one level. Siblings
+// are child_gap of their parent apart, cousins the wider of both gaps.
+static int tidy_sep(TreeStore *t, uint32_t l, uint32_t r)
+{
+    int gap = t->child_gap[t->parent[l]];
+    if (t->parent[l] != t->parent[r] && t->child_gap[t->parent[r]] > gap)
+        gap = t->child_gap[t->parent[r]];
+    return (t->draw_width[l] + t->draw_width[r] + 1) / 2 + gap;
+}
+
+// Next node down the left or right contour of a subtree
+static uint32_t tidy_next_left(TreeStore *t, uint32_t v)
+{
+    return t->first_child[v] != NO_NODE ? t->first_child[v] : t->thread[v];
+}
+
+static uint32_t tidy_next_right(TreeStore *t, uint32_t v)
+{
+    return t->last_child[v] != NO_NODE ? t->last_child[v] : t->thread[v];
+}
+
+// Moves the subtree of wr right by shift and spreads the move over the
+// siblings between wl and wr, see tidy_execute_shifts()
+static void tidy_move_subtree(TreeStore *t, uint32_t wl, uint32_t wr, int shift)
+{
+    int subtrees = t->number[wr] - t->number[wl];
+    int step = shift / subtrees;
+    t->change[wr] -= step;
+    t->change[wl] += step;
+    // the remainder stays on wr, so wl and whatever is left of it keep still
+    t->shift[wr] += step * subtrees;
+    t->prelim[wr] += shift;
+    t->mod[wr] += shift;
+}
+
+static void tidy_execute_shifts(TreeStore *t, uint32_t v)
+{
+    int shift = 0, change = 0;
+    for (uint32_t c = t->last_child[v]; c != NO_NODE; c = t->prev_sibling[c])
+    {
+        t->prelim[c] += shift;
+        t->mod[c] += shift;
+        change += t->change[c];
+        shift += t->shift[c] + change;
+    }
+}
+
+// Pushes the subtree of v right until it clears the subtrees of its left
+// siblings, walking the facing contours level by level. Returns the new
+// default ancestor.
+static uint32_t tidy_apportion(TreeStore *t, uint32_t v, uint32_t default_ancestor)
+{
+    uint32_t w = t->prev_sibling[v];
+    if (w == NO_NODE)
+        return default_ancestor;
+
+    // inner and outer contours on the right (p) and left (m) side
+    uint32_t vip = v, vop = v, vim = w, vom = t->first_child[t->parent[v]];
+    int sip = t->mod[vip], sop = t->mod[vop], sim = t->mod[vim], som = t->mod[vom];
+    uint32_t next_im = tidy_next_right(t, vim), next_ip = tidy_next_left(t, vip);
+    while (next_im != NO_NODE && next_ip != NO_NODE)
+    {
+        vim = next_im;
+        vip = next_ip;
+        vom = tidy_next_left(t, vom);
+        vop = tidy_next_right(t, vop);
+        t->ancestor[vop] = v;
+
+        int shift = (t->prelim[vim] + sim) - (t->prelim[vip] + sip) + tidy_sep(t, vim, vip);
+        if (shift > 0)
+        {
+            uint32_t a = t->ancestor[vim];
+            if (t->parent[a] != t->parent[v])
+                a = default_ancestor;
+            tidy_move_subtree(t, a, v, shift);
+            sip += shift;
+            sop += shift;
+        }
+        sim += t->mod[vim];
+        sip += t->mod[vip];
+        som += t->mod[vom];
+        sop += t->mod[vop];
+        next_im = tidy_next_right(t, vim);
+        next_ip = tidy_next_left(t, vip);
+    }
+
+    // thread the shorter side onto the deeper one
+    if (next_im != NO_NODE && tidy_next_right(t, vop) == NO_NODE)
+    {
+        t->thread[vop] = next_im;
+        t->mod[vop] += sim - sop;
+    }
+    if (next_ip != NO_NODE && tidy_next_left(t, vom) == NO_NODE)
+    {
+        t->thread[vom] = next_ip;
+        t->mod[vom] += sip - som;
+        default_ancestor = v;
+    }
+    return default_ancestor;
+}
+
+// First walk of node i, once the subtree of every child is laid out:
+// places the children next to each other and i centred over them
+static void tidy_first_walk(TreeStore *t, uint32_t i)
+{
+    uint32_t first = t->first_child[i];
+    if (first == NO_NODE)
+    {
+        t->prelim[i] = 0;
+        return;
+    }
+
+    uint32_t default_ancestor = first;
+    for (uint32_t c = first; c != NO_NODE; c = t->next_sibling[c])
+    {
+        // so far prelim[c] is the midpoint of c's children
+        uint32_t l = t->prev_sibling[c];
+        if (l != NO_NODE)
+        {
+            int mid = t->prelim[c];
+            t->prelim[c] = t->prelim[l] + tidy_sep(t, l, c);
+            if (t->first_child[c] != NO_NODE)
+                t->mod[c] = t->prelim[c] - mid;
+        }
+        default_ancestor = tidy_apportion(t, c, default_ancestor);
+    }
+    tidy_execute_shifts(t, i);
+    t->prelim[i] = (t->prelim[first] + t->prelim[t->last_child[i]]) / 2;
+}
+
+// Second walk of node i, once its parent is placed: the centre is prelim
+// plus the mods of every ancestor, which the parent's centre already holds
+static void tidy_second_walk(TreeStore *t, uint32_t i)
+{
+    uint32_t p = t->parent[i];
+    int m = p == NO_NODE ? 0 : t->draw_x[p] + t->draw_width[p] / 2 - t->prelim[p] + t->mod[p];
+    t->draw_x[i] = t->prelim[i] + m - t->draw_width[i] / 2;
+}
+
+#ifndef _WIN32
+// Both walks on the pool. The first walk of a node only touches the
+// subtrees of its children and the second only needs the parent, so
+// sibling subtrees are laid out by separate tasks, each scanning its
+// range of the store like the serial walk does. The result is the same.
+#define LAYOUT_TASK_MIN 4096 // nodes, smaller sibling subtrees share a task
+#define LAYOUT_PARALLEL_MIN (8 * LAYOUT_TASK_MIN)
+
+typedef struct
+{
+    Pool *pool;
+    TreeStore *t;
+    atomic_int *pending; // children whose first walk is not done yet
+} LayoutJob;
+
+// cnt whole sibling subtrees [from, to), children of parent
+typedef struct
+{
+    LayoutJob *job;
+    bool first_walk; // else the second
+    uint32_t parent;
+    uint32_t from;
+    uint32_t to;
+    int cnt;
+} LayoutTask;
+
+static void layout_run(LayoutTask *task);
+
+static void layout_task(void *arg)
+{
+    LayoutTask task = *(LayoutTask *)arg;
+    free(arg);
+    layout_run(&task);
+}
+
+// Hands the children of v out as tasks: a big subtree on its own, runs of
+// small ones together
+static void layout_spawn(LayoutJob *job, uint32_t v, bool first_walk)
+{
+    TreeStore *t = job->t;
+    if (first_walk)
+    {
+        int cnt = 0;
+        for (uint32_t c = t->first_child[v]; c != NO_NODE; c = t->next_sibling[c])
+            cnt++;
+        atomic_store(&job->pending[v], cnt);
+    }
+
+    uint32_t c = t->first_child[v];
+    while (c != NO_NODE)
+    {
+        LayoutTask task = {job, first_walk, v, c, 0, 0};
+        while (c != NO_NODE && (task.cnt == 0 || t->subtree_end[c] - task.from <= LAYOUT_TASK_MIN))
+        {
+            task.cnt++;
+            c = t->next_sibling[c];
+        }
+        task.to = c != NO_NODE ? c : t->subtree_end[v];
+
+        LayoutTask *sub = (LayoutTask *)malloc(sizeof(LayoutTask));
+        if (sub)
+        {
+            *sub = task;
+            pool_submit(job->pool, layout_task, sub);
+        }
+        else
+        {
+            layout_run(&task);
+        }
+    }
+}
+
+// cnt children of p are done; the last one in does p, and so on upwards
+static void layout_finish(LayoutJob *job, uint32_t p, int cnt)
+{
+    while (p != NO_NODE && atomic_fetch_sub(&job->pending[p], cnt) == cnt)
+    {
+        tidy_first_walk(job->t, p);
+        p = job->t->parent[p];
+        cnt = 1;
+    }
+}
+
+static void layout_run(LayoutTask *task)
+{
+    LayoutJob *job = task->job;
+    TreeStore *t = job->t;
+    bool split = task->cnt == 1 && task->to - task->from > LAYOUT_TASK_MIN;
+
+    if (task->first_walk)
+    {
+        if (split)
+        {
+            // from is done by the last of its children to finish
+            layout_spawn(job, task->from, true);
+            return;
+        }
+        for (uint32_t i = task->to; i-- > task->from;)
+        {
+            tidy_first_walk(t, i);
+        }
+        layout_finish(job, task->parent, task->cnt);
+    }
+    else
+    {
+        if (split)
+        {
+            tidy_second_walk(t, task->from);
+            layout_spawn(job, task->from, false);
+            return;
+        }
+        for (uint32_t i = task->from; i < task->to; i++)
+        {
+            tidy_second_walk(t, i);
+        }
+    }
+}
+
+// false when the tree is too small or there is one thread only
+static bool layout_parallel(TreeStore *t, Pool *pool)
+{
+    if (t->cnt < LAYOUT_PARALLEL_MIN || !pool || pool_size(pool) < 2)
+        return false;
+    LayoutJob job = {pool, t, NULL};
+    if (!(job.pending = (atomic_int *)calloc(t->cnt, sizeof(atomic_int))))
+        return false;
+
+    // the second walk starts once the first one is done everywhere
+    for (int walk = 0; walk < 2; walk++)
+    {
+        LayoutTask root = {&job, walk == 0, NO_NODE, 0, t->cnt, 1};
+        layout_run(&root);
+        pool_wait(pool);
+    }
+
+    free(job.pending);
+    return true;
+}
+#else
+static bool layout_parallel(TreeStore *t, Pool *pool)
+{
+    (void)t;
+    (void)pool;
+    return false;
+}
+#endif
+
+// Prepare data for drawing tree.
+// A forward scan sizes every node and picks the gap between its children:
+// tree_data->gap, or less for a parent whose row of children would not fit
+// the canvas. Only that family is squeezed, and both walks below read the
+// same per-parent gap, so the layout is decided in one pass. The x positions
+// come from the tidy tree layout of Buchheim, Jünger and Leipert (Walker's
+// algorithm in linear time): subtrees are packed against each other along
+// their contours and parents sit centred over their children. Its first
+// walk is post-order, which is the pre-order store scanned backwards; its
+// second walk is the store scanned forwards. Big trees run both walks on
+// the pool, see layout_parallel().
+// Coordinates are relative to the root, measure_tree() moves them onto
+// the canvas.
+void prepare_drawing_tree(TreeStore *t, TreeData *tree_data)
+{
+    if (!t || !tree_data || t->cnt == 0)
+    {
+        return;
+    }
+
+    int rh = BITMAP_SIZE - 1 + tree_data->internal_padd * 2;
+
+    for (uint32_t i = 0; i < t->cnt; i++)
+    {
+        int title_size = t->label_len[i];
+        // -1 -> whitespace on the bitmap
+        int rw = BITMAP_SIZE * title_size * tree_data->scale - 1 + tree_data->internal_padd * 2;
+
+        if (t->type[i] == PARENT)
+        {
+            int child_cnt = t->child_cnt[i];
+            int gap_num = (child_cnt > 0) ? (child_cnt - 1) : 0;
+            int total_gap = tree_data->gap * gap_num;
+            int next_level_expected_width =
+                t->children_name_len[i] * BITMAP_SIZE * tree_data->scale +
+                ((tree_data->internal_padd * 2) * child_cnt) - child_cnt;
+
+            t->child_gap[i] = tree_data->gap;
+            if (gap_num > 0 && next_level_expected_width + total_gap > tree_data->max_canvas_width)
+            {
+                int new_gap = (tree_data->max_canvas_width - next_level_expected_width + child_cnt) / gap_num;
+                t->child_gap[i] = new_gap > 0 ? new_gap : 0;
+                tree_data->narrowed++;
+            }
+
+            tree_data->parent_cnt = tree_data->parent_cnt + 1;
+            t->color[i] = COLOR_RED;
+        }
+        else
+        {
+            t->color[i] = COLOR_YELLOW;
+            t->child_gap[i] = tree_data->gap;
+        }
+
+        uint32_t p = t->parent[i];
+        t->draw_y[i] = p == NO_NODE ? 0 : t->draw_y[p] + rh + tree_data->arrow_length + 40;
+        t->draw_width[i] = rw;
+        t->draw_height[i] = rh;
+        t->flags[i] = NODE_LAID;
+        if (p != NO_NODE && t->first_child[p] == i)
+        {
+            t->flags[i] |= NODE_FIRST_CHILD;
+            t->prev_sibling[i] = NO_NODE;
+            t->number[i] = 0;
+        }
+        if (t->next_sibling[i] != NO_NODE)
+        {
+            t->flags[i] |= NODE_HAS_GAP;
+            t->prev_sibling[t->next_sibling[i]] = i;
+            t->number[t->next_sibling[i]] = t->number[i] + 1;
+        }
+        if (p == NO_NODE)
+        {
+            t->prev_sibling[i] = NO_NODE;
+            t->number[i] = 0;
+        }
+        t->thread[i] = NO_NODE;
+        t->ancestor[i] = i;
+        t->mod[i] = 0;
+        t->shift[i] = 0;
+        t->change[i] = 0;
+    }
+
+    if (layout_parallel(t, tree_data->pool))
+    {
+        return;
+    }
+
+    // first walk: descendants sit after a node, so a backward scan has
+    // every subtree of a node laid out before the node itself
+    for (uint32_t i = t->cnt; i-- > 0;)
+    {
+        tidy_first_walk(t, i);
+    }
+    for (uint32_t i = 0; i < t->cnt; i++)
+    {
+        tidy_second_walk(t, i);
+    }
+}
+
+// Bounding box of everything draw_tree() paints. Shifts the layout so the
+// box starts at IMG_MARGIN and stores the canvas size it needs.
+void measure_tree(TreeStore *t, TreeData *tree_data)
+{
+    if (!t || t->cnt == 0)
+    {
+        tree_data->max_width_needed = 0;
+        tree_data->max_height_needed = 0;
+        return;
+    }
+
+    int min_x = INT_MAX, max_x = INT_MIN, max_y = INT_MIN;
+    for (uint32_t i = 0; i < t->cnt; i++)
+    {
+        int x = t->draw_x[i];
+        int bottom = t->draw_y[i] + t->draw_height[i];
+        if (t->type[i] == PARENT)
+        {
+            // arrow below the box
+            bottom += tree_data->arrow_length + 1;
+        }
+        if (x < min_x)
+            min_x = x;
+        if (x + t->draw_width[i] > max_x)
+            max_x = x + t->draw_width[i];
+        if (bottom > max_y)
+            max_y = bottom;
+    }
+
+    int shift = IMG_MARGIN - min_x;
+    for (uint32_t i = 0; i < t->cnt; i++)
+    {
+        t->draw_x[i] += shift;
+    }
+
+    tree_data->max_width_needed = max_x - min_x + IMG_MARGIN * 2;
+    tree_data->max_height_needed = max_y + IMG_MARGIN;
+}
+
+void draw_tree_node(Canvas *canvas, TreeStore *t, TreeData *tree_data, uint32_t i)
+{
+    int x = t->draw_x[i];
+    int y = t->draw_y[i];
+    int w = t->draw_width[i];
+    int h = t->draw_height[i];
+
+    fill_rect(canvas, x, y, w, h, t->color[i]);
+    const char *name = t->names + t->name_off[i];
+    int tx = x + tree_data->internal_padd;
+    int ty = y + tree_data->internal_padd;
+    draw_text_len(canvas, tx, ty, name, t->label_bytes[i], tree_data->scale);
+    if (name[t->label_bytes[i]] != '\0')
+    {
+        int cut = t->label_len[i] - LABEL_ELLIPSIS_LEN;
+        draw_text_scale(canvas, tx + cut * BITMAP_SIZE * tree_data->scale, ty,
+                        LABEL_ELLIPSIS, tree_data->scale);
+    }
+    if (t->type[i] == PARENT)
+    {
+        draw_arrow(
+            canvas,
+            x + w / 2, y + h + 2,
+            x + w / 2, y + h + tree_data->arrow_length);
+    }
+}
+
+// Rectangle [x0, x1) x [y0, y1) that draw_tree_node() may touch
+void tree_node_bounds(TreeStore *t, TreeData *tree_data, uint32_t i,
+                      int *x0, int *y0, int *x1, int *y1)
+{
+    *x0 = t->draw_x[i];
+    *y0 = t->draw_y[i];
+    *x1 = t->draw_x[i] + t->draw_width[i];
+    *y1 = t->draw_y[i] + t->draw_height[i];
+    if (t->type[i] == PARENT)
+    {
+        // arrow below the box, its head is 5 px wide on each side
+        int mid = t->draw_x[i] + t->draw_width[i] / 2;
+        if (mid - 5 < *x0)
+            *x0 = mid - 5;
+        if (mid + 6 > *x1)
+            *x1 = mid + 6;
+        *y1 += tree_data->arrow_length + 1;
+    }
+}
+
+// Bounds of every subtree, from the nodes' own bounds, and for each node
+// the reach of its siblings on either side. Along a child list reach_x0
+// and reach_x1 never go down, so the children a rectangle can meet are
+// found with two binary searches.
+void measure_subtrees(TreeStore *t, TreeData *tree_data)
+{
+    for (uint32_t i = 0; i < t->cnt; i++)
+    {
+        int y0;
+        tree_node_bounds(t, tree_data, i, &t->span_x0[i], &y0, &t->span_x1[i], &t->span_y1[i]);
+    }
+    for (uint32_t i = t->cnt; i-- > 1;)
+    {
+        uint32_t p = t->parent[i];
+        if (t->span_x0[i] < t->span_x0[p])
+            t->span_x0[p] = t->span_x0[i];
+        if (t->span_x1[i] > t->span_x1[p])
+            t->span_x1[p] = t->span_x1[i];
+        if (t->span_y1[i] > t->span_y1[p])
+            t->span_y1[p] = t->span_y1[i];
+    }
+
+    t->reach_x0[0] = t->span_x0[0];
+    t->reach_x1[0] = t->span_x1[0];
+    for (uint32_t i = 0; i < t->cnt; i++)
+    {
+        const uint32_t *c = t->children + t->child_start[i];
+        int n = t->child_cnt[i];
+        for (int k = 0; k < n; k++)
+        {
+            int prev = k > 0 ? t->reach_x1[c[k - 1]] : INT_MIN;
+            t->reach_x1[c[k]] = t->span_x1[c[k]] > prev ? t->span_x1[c[k]] : prev;
+        }
+        for (int k = n; k-- > 0;)
+        {
+            int next = k + 1 < n ? t->reach_x0[c[k + 1]] : INT_MAX;
+            t->reach_x0[c[k]] = t->span_x0[c[k]] < next ? t->span_x0[c[k]] : next;
+        }
+    }
+}
+
+void draw_tree(Canvas *canvas, TreeStore *t, TreeData tree_data)
+{
+    if (!canvas || !t)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < t->cnt; i++)
+    {
+        if (!(t->flags[i] & NODE_LAID))
+            continue;
+
+        draw_tree_node(canvas, t, &tree_data, i);
+    }
+}
+
+#define GRID_MIN_CELL 64
+
+static int grid_col(const NodeGrid *g, int x)
+{
+    int c = x < 0 ? 0 : x / g->cell;
+    return c < g->cols ? c : g->cols - 1;
+}
+
+static int grid_row(const NodeGrid *g, int y)
+{
+    int r = y < 0 ? 0 : y / g->cell;
+    return r < g->rows ? r : g->rows - 1;
+}
+
+// Indexes every laid node of the measured layout, cells are sized so there
+// are about as many cells as nodes
+bool build_node_grid(TreeStore *t, TreeData *tree_data)
+{
+    NodeGrid *g = &t->grid;
+    free(g->start);
+    free(g->ids);
+    memset(g, 0, sizeof(*g));
+
+    long long w = tree_data->max_width_needed > 0 ? tree_data->max_width_needed : 1;
+    long long h = tree_data->max_height_needed > 0 ? tree_data->max_height_needed : 1;
+    long long cell = GRID_MIN_CELL;
+    while ((w / cell + 1) * (h / cell + 1) > (long long)t->cnt + 1)
+        cell *= 2;
+    g->cell = (int)cell;
+    g->cols = (int)(w / cell + 1);
+    g->rows = (int)(h / cell + 1);
+
+    size_t cells = (size_t)g->cols * g->rows;
+    g->start = (uint32_t *)calloc(cells + 1, sizeof(uint32_t));
+    if (!g->start)
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+        return false;
+    }
+
+    // count, prefix sum, fill
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (uint32_t i = 0; i < t->cnt; i++)
+        {
+            if (!(t->flags[i] & NODE_LAID))
+                continue;
+
+            int x0, y0, x1, y1;
+            tree_node_bounds(t, tree_data, i, &x0, &y0, &x1, &y1);
+            int c0 = grid_col(g, x0), c1 = grid_col(g, x1 - 1);
+            int r0 = grid_row(g, y0), r1 = grid_row(g, y1 - 1);
+            for (int r = r0; r <= r1; r++)
+            {
+                for (int c = c0; c <= c1; c++)
+                {
+                    size_t k = (size_t)r * g->cols + c;
+                    if (pass == 0)
+                        g->start[k + 1]++;
+                    else
+                        g->ids[g->start[k]++] = i;
+                }
+            }
+        }
+
+        if (pass == 0)
+        {
+            for (size_t k = 0; k < cells; k++)
+                g->start[k + 1] += g->start[k];
+            g->ids = (uint32_t *)malloc(sizeof(uint32_t) * (g->start[cells] ? g->start[cells] : 1));
+            if (!g->ids)
+            {
+                fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+                free(g->start);
+                memset(g, 0, sizeof(*g));
+                return false;
+            }
+        }
+    }
+    // the fill pass moved every start one cell forward
+    for (size_t k = cells; k > 0; k--)
+        g->start[k] = g->start[k - 1];
+    g->start[0] = 0;
+    return true;
+}
+
+static bool node_hits_push(NodeHits *hits, uint32_t i)
+{
+    if (hits->cnt == hits->cap)
+    {
+        size_t cap = hits->cap ? hits->cap * 2 : 256;
+        uint32_t *ids = (uint32_t *)realloc(hits->ids, sizeof(uint32_t) * cap);
+        if (!ids)
+        {
+            fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+            return false;
+        }
+        hits->ids = ids;
+        hits->cap = cap;
+    }
+    hits->ids[hits->cnt++] = i;
+    return true;
+}
+
+static int cmp_uint32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Sets hits to the laid nodes whose bounds meet [x0, x1) x [y0, y1), each
+// once and in store order, so drawing them matches draw_tree()
+bool node_grid_query(TreeStore *t, TreeData *tree_data, int x0, int y0, int x1, int y1, NodeHits *hits)
+{
+    const NodeGrid *g = &t->grid;
+    hits->cnt = 0;
+    if (x0 >= x1 || y0 >= y1)
+        return true;
+
+    if (!g->start)
+    {
+        // no index, look at every node
+        for (uint32_t i = 0; i < t->cnt; i++)
+        {
+            int bx0, by0, bx1, by1;
+            tree_node_bounds(t, tree_data, i, &bx0, &by0, &bx1, &by1);
+            if ((t->flags[i] & NODE_LAID) && bx1 > x0 && bx0 < x1 && by1 > y0 && by0 < y1 &&
+                !node_hits_push(hits, i))
+                return false;
+        }
+        return true;
+    }
+
+    int c0 = grid_col(g, x0), c1 = grid_col(g, x1 - 1);
+    int r0 = grid_row(g, y0), r1 = grid_row(g, y1 - 1);
+    for (int r = r0; r <= r1; r++)
+    {
+        for (int c = c0; c <= c1; c++)
+        {
+            size_t k = (size_t)r * g->cols + c;
+            for (uint32_t n = g->start[k]; n < g->start[k + 1]; n++)
+            {
+                uint32_t i = g->ids[n];
+                int bx0, by0, bx1, by1;
+                tree_node_bounds(t, tree_data, i, &bx0, &by0, &bx1, &by1);
+                if (bx1 <= x0 || bx0 >= x1 || by1 <= y0 || by0 >= y1)
+                    continue;
+                // a node is in every cell it covers, only the first cell of
+                // its overlap with the query reports it
+                if (grid_col(g, bx0 > x0 ? bx0 : x0) != c || grid_row(g, by0 > y0 ? by0 : y0) != r)
+                    continue;
+                if (!node_hits_push(hits, i))
+                    return false;
+            }
+        }
+    }
+    if (hits->cnt > 1)
+        qsort(hits->ids, hits->cnt, sizeof(uint32_t), cmp_uint32);
+    return true;
+}
+
+// Topmost laid node drawn at (x, y), NO_NODE when there is none
+uint32_t node_grid_at(TreeStore *t, TreeData *tree_data, int x, int y)
+{
+    NodeHits hits = {NULL, 0, 0};
+    uint32_t found = NO_NODE;
+    if (node_grid_query(t, tree_data, x, y, x + 1, y + 1, &hits) && hits.cnt > 0)
+        found = hits.ids[hits.cnt - 1];
+    free(hits.ids);
+    return found;
+}
+
+// Runs the layout and decides the canvas size
+void layout_tree(TreeStore *t, TreeData *tree_data)
+{
+    // INIT TREE DATA
+    tree_data->max_width_needed = 0;
+    tree_data->max_height_needed = 0;
+    tree_data->parent_cnt = 0;
+    tree_data->scale = 1;
+    tree_data->internal_padd = 3;
+    tree_data->arrow_length = 20;
+    tree_data->gap = 100;
+    tree_data->narrowed = 0;
+
+    prepare_drawing_tree(t, tree_data);
+    printf("gap: %d\n", tree_data->gap);
+    if (tree_data->narrowed > 0)
+    {
+        printf("WARNING: Children of %d directories wider than the canvas, narrowed their gap.\n",
+               tree_data->narrowed);
+    }
+    measure_tree(t, tree_data);
+    measure_subtrees(t, tree_data);
+    build_node_grid(t, tree_data);
+
+    int w = tree_data->max_width_needed;
+    int h = tree_data->max_height_needed;
+    if (w > tree_data->max_canvas_width || h > tree_data->max_canvas_height)
+    {
+        printf("WARNING: Tree needs %dx%d, cut to %dx%d.\n",
+               w, h, tree_data->max_canvas_width, tree_data->max_canvas_height);
+        if (w > tree_data->max_canvas_width)
+            w = tree_data->max_canvas_width;
+        if (h > tree_data->max_canvas_height)
+            h = tree_data->max_canvas_height;
+    }
+    tree_data->canvas_width = w;
+    tree_data->canvas_height = h;
+
+    // background, lines and text, then the box colours
+    tree_data->palette.cnt = 0;
+    palette_add(&tree_data->palette, COLOR_WHITE);
+    palette_add(&tree_data->palette, COLOR_BLACK);
+    for (uint32_t i = 0; i < t->cnt; i++)
+    {
+        if ((t->flags[i] & NODE_LAID) && palette_add(&tree_data->palette, t->color[i]) < 0)
+        {
+            printf("WARNING: More than 256 colours, writing RGB.\n");
+            tree_data->channels = 3;
+            break;
+        }
+    }
+}
+
+// Sets up c as the whole canvas, or a part of it, in the tree's pixel format
+static void init_canvas(Canvas *c, TreeData *tree_data, unsigned char *img, int x0, int y0, int w, int h, size_t stride)
+{
+    c->img = img;
+    c->w = w;
+    c->h = h;
+    c->x0 = x0;
+    c->y0 = y0;
+    c->stride = stride;
+    c->channels = tree_data->channels;
+    c->palette = &tree_data->palette;
+}
+
+
+typedef void (*band_fn)(void *user, const unsigned char *rows, int y, int h, size_t stride);
+
+#define TILE_SIZE 256
+
+// Renders the canvas one row of tiles at a time and hands every finished
+// band to emit(). Each tile asks the node grid for the nodes that touch it
+// and draws them in store order so the pixels match draw_tree(). Memory
+// stays at one band, whatever the height.
+bool render_tiled(TreeStore *t, TreeData *tree_data, int tile, band_fn emit, void *user)
+{
+    int w = tree_data->canvas_width;
+    int channels = tree_data->channels;
+    size_t stride = (size_t)w * channels;
+    unsigned char *band = (unsigned char *)malloc(stride * tile);
+    if (!band)
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+        return false;
+    }
+
+    NodeHits hits = {NULL, 0, 0};
+    bool ok = true;
+    for (int y = 0; ok && y < tree_data->canvas_height; y += tile)
+    {
+        int h = tree_data->canvas_height - y < tile ? tree_data->canvas_height - y : tile;
+        Canvas whole;
+        init_canvas(&whole, tree_data, band, 0, y, w, h, stride);
+        fill_rect(&whole, 0, y, w, h, COLOR_WHITE);
+
+        for (int x = 0; ok && x < w; x += tile)
+        {
+            Canvas c;
+            init_canvas(&c, tree_data, band + (size_t)x * channels, x, y, w - x < tile ? w - x : tile, h, stride);
+            ok = node_grid_query(t, tree_data, x, y, x + c.w, y + h, &hits);
+            for (size_t k = 0; ok && k < hits.cnt; k++)
+            {
+                draw_tree_node(&c, t, tree_data, hits.ids[k]);
+            }
+        }
+
+        if (ok)
+            emit(user, band, y, h, stride);
+    }
+
+    free(band);
+    free(hits.ids);
+    return ok;
+}
+
+#ifndef _WIN32
+#define DRAW_BAND_HEIGHT 64
+
+typedef struct
+{
+    TreeStore *t;
+    TreeData *tree_data;
+    Canvas *canvas;
+    atomic_bool failed;
+} DrawJob;
+
+typedef struct
+{
+    DrawJob *job;
+    int y;
+} DrawTask;
+
+static void draw_band_task(void *arg)
+{
+    DrawTask *task = (DrawTask *)arg;
+    DrawJob *job = task->job;
+    Canvas *canvas = job->canvas;
+
+    int y = task->y;
+    int h = canvas->h - y < DRAW_BAND_HEIGHT ? canvas->h - y : DRAW_BAND_HEIGHT;
+    Canvas c;
+    init_canvas(&c, job->tree_data, canvas->img + (size_t)y * canvas->stride, 0, y, canvas->w, h, canvas->stride);
+    fill_rect(&c, 0, y, c.w, h, COLOR_WHITE);
+
+    NodeHits hits = {NULL, 0, 0};
+    if (!node_grid_query(job->t, job->tree_data, 0, y, c.w, y + h, &hits))
+        atomic_store(&job->failed, true);
+    for (size_t k = 0; k < hits.cnt; k++)
+    {
+        draw_tree_node(&c, job->t, job->tree_data, hits.ids[k]);
+    }
+    free(hits.ids);
+}
+
+// Clears and draws the whole canvas in row bands on the pool. A band task
+// writes its own rows only, through a canvas clipped to them, so the bands
+// need no locking and the pixels match draw_tree(). False when there is
+// nothing to split it over, the caller then draws it serially.
+static bool draw_tree_banded(Canvas *canvas, TreeStore *t, TreeData *tree_data)
+{
+    Pool *pool = tree_data->pool;
+    if (canvas->h < 2 * DRAW_BAND_HEIGHT || !pool || pool_size(pool) < 2)
+        return false;
+    int band_cnt = (canvas->h + DRAW_BAND_HEIGHT - 1) / DRAW_BAND_HEIGHT;
+    DrawTask *tasks = (DrawTask *)malloc(sizeof(DrawTask) * band_cnt);
+    if (!tasks)
+        return false;
+
+    // the bands would all build the glyph cache on their first label
+    text_init();
+    DrawJob job = {t, tree_data, canvas, false};
+    for (int band = 0; band < band_cnt; band++)
+    {
+        tasks[band].job = &job;
+        tasks[band].y = band * DRAW_BAND_HEIGHT;
+        pool_submit(pool, draw_band_task, &tasks[band]);
+    }
+    pool_wait(pool);
+    free(tasks);
+
+    // a band that ran out of memory is drawn again serially
+    return !atomic_load(&job.failed);
+}
+#else
+static bool draw_tree_banded(Canvas *canvas, TreeStore *t, TreeData *tree_data)
+{
+    (void)canvas;
+    (void)t;
+    (void)tree_data;
+    return false;
+}
+#endif
+
+// Lays the tree out, allocates a canvas that fits it and draws it
+bool load_tree(TreeStore *t, TreeData *tree_data, Canvas *canvas)
+{
+    if (canvas == NULL || t == NULL)
+    {
+        fprintf(stderr, "ERROR: NULL PARAMETERS");
+        return false;
+    }
+
+    layout_tree(t, tree_data);
+
+    size_t stride = (size_t)tree_data->canvas_width * tree_data->channels;
+    unsigned char *img = malloc(stride * tree_data->canvas_height);
+    if (img == NULL)
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY FOR IMG");
+        return false;
+    }
+    init_canvas(canvas, tree_data, img, 0, 0, tree_data->canvas_width, tree_data->canvas_height, stride);
+
+    if (!draw_tree_banded(canvas, t, tree_data))
+    {
+        // white background
+        fill_rect(canvas, 0, 0, canvas->w, canvas->h, COLOR_WHITE);
+
+        draw_tree(canvas, t, *tree_data);
+    }
+    return true;
+}
+
+// Node at path, relative to the root and '/' separated, NO_NODE if there
+// is none. An empty path or "." is the root.
+uint32_t tree_store_find(TreeStore *t, const char *path)
+{
+    if (!t || t->cnt == 0)
+        return NO_NODE;
+
+    uint32_t i = 0;
+    while (*path)
+    {
+        const char *end = strchr(path, '/');
+        size_t len = end ? (size_t)(end - path) : strlen(path);
+        if (len > 0 && !(len == 1 && path[0] == '.'))
+        {
+            uint32_t c = t->first_child[i];
+            while (c != NO_NODE)
+            {
+                const char *name = t->names + t->name_off[c];
+                if (strncmp(name, path, len) == 0 && name[len] == '\0')
+                    break;
+                c = t->next_sibling[c];
+            }
+            if (c == NO_NODE)
+                return NO_NODE;
+            i = c;
+        }
+        path += len;
+        if (*path == '/')
+            path++;
+    }
+    return i;
+}
+
+// Fills in the view's rectangle once the layout is done: the crop if one
+// was given (relative to the subtree, if any), else the subtree's bounds,
+// else the whole tree. The rectangle is clipped to the tree and the output
+// to the canvas cap.
+bool view_resolve(View *v, TreeStore *t, TreeData *tree_data, bool cropped)
+{
+    int x0 = 0, y0 = 0;
+    int x1 = tree_data->max_width_needed, y1 = tree_data->max_height_needed;
+    if (v->root != NO_NODE)
+    {
+        x0 = t->span_x0[v->root] - IMG_MARGIN;
+        y0 = t->draw_y[v->root] - IMG_MARGIN;
+        x1 = t->span_x1[v->root] + IMG_MARGIN;
+        y1 = t->span_y1[v->root] + IMG_MARGIN;
+    }
+    if (cropped)
+    {
+        x0 += v->x;
+        y0 += v->y;
+        x1 = x0 + v->w;
+        y1 = y0 + v->h;
+    }
+
+    if (x0 < 0)
+        x0 = 0;
+    if (y0 < 0)
+        y0 = 0;
+    if (x1 > tree_data->max_width_needed)
+        x1 = tree_data->max_width_needed;
+    if (y1 > tree_data->max_height_needed)
+        y1 = tree_data->max_height_needed;
+    if (x0 >= x1 || y0 >= y1)
+    {
+        fprintf(stderr, "ERROR: VIEW IS OUTSIDE THE TREE\n");
+        return false;
+    }
+
+    // output pixels per layout pixel are zoom / shrink
+    long long out_w = ((long long)(x1 - x0) * v->zoom + v->shrink - 1) / v->shrink;
+    long long out_h = ((long long)(y1 - y0) * v->zoom + v->shrink - 1) / v->shrink;
+    if (out_w > tree_data->max_canvas_width || out_h > tree_data->max_canvas_height)
+    {
+        printf("WARNING: View needs %lldx%lld, cut to %dx%d.\n",
+               out_w, out_h, tree_data->max_canvas_width, tree_data->max_canvas_height);
+        if (out_w > tree_data->max_canvas_width)
+            x1 = x0 + (int)((long long)tree_data->max_canvas_width * v->shrink / v->zoom);
+        if (out_h > tree_data->max_canvas_height)
+            y1 = y0 + (int)((long long)tree_data->max_canvas_height * v->shrink / v->zoom);
+    }
+
+    if (v->lod > 0 && tree_data->channels == 1 && palette_add(&tree_data->palette, COLOR_AGGREGATE) < 0)
+    {
+        printf("WARNING: More than 256 colours, writing RGB.\n");
+        tree_data->channels = 3;
+    }
+
+    v->x = x0;
+    v->y = y0;
+    v->w = x1 - x0;
+    v->h = y1 - y0;
+    tree_data->canvas_width = (int)(((long long)v->w * v->zoom + v->shrink - 1) / v->shrink);
+    tree_data->canvas_height = (int)(((long long)v->h * v->zoom + v->shrink - 1) / v->shrink);
+    return true;
+}
+
+// draw_tree_node() shrink times smaller, on a canvas in shrunk pixels.
+// Boxes keep at least one pixel, labels are too small to draw.
+static void draw_tree_node_shrunk(Canvas *canvas, TreeStore *t, TreeData *tree_data, uint32_t i, int shrink)
+{
+    int x = t->draw_x[i];
+    int y = t->draw_y[i];
+    int w = t->draw_width[i];
+    int h = t->draw_height[i];
+
+    int sx = x / shrink, sy = y / shrink;
+    fill_rect(canvas, sx, sy, (x + w - 1) / shrink + 1 - sx, (y + h - 1) / shrink + 1 - sy, t->color[i]);
+    if (t->type[i] == PARENT)
+    {
+        int mid = (x + w / 2) / shrink;
+        draw_line(canvas, mid, (y + h + 2) / shrink, mid, (y + h + tree_data->arrow_length) / shrink);
+    }
+}
+
+// Every node of the view the grid finds in its rectangle
+static bool draw_view_nodes(Canvas *c, TreeStore *t, TreeData *tree_data, const View *v)
+{
+    NodeHits hits = {NULL, 0, 0};
+    if (!node_grid_query(t, tree_data, v->x, v->y, v->x + v->w, v->y + v->h, &hits))
+        return false;
+
+    uint32_t first = v->root != NO_NODE ? v->root : 0;
+    uint32_t end = v->root != NO_NODE ? t->subtree_end[v->root] : t->cnt;
+    for (size_t k = 0; k < hits.cnt; k++)
+    {
+        uint32_t i = hits.ids[k];
+        if (i < first || i >= end)
+            continue;
+        if (v->shrink > 1)
+            draw_tree_node_shrunk(c, t, tree_data, i, v->shrink);
+        else
+            draw_tree_node(c, t, tree_data, i);
+    }
+    free(hits.ids);
+    return true;
+}
+
+// Level of detail: a subtree narrower than View::lod output pixels is not
+// drawn node by node but as one box with its counts, and so is a run of
+// such siblings. The walk stops at those boxes and skips the children
+// outside the view, so its cost follows the output, not the tree.
+typedef struct
+{
+    uint32_t p;
+    int k;   // next child to look at
+    int end; // past the last child that may meet the view
+} LodFrame;
+
+typedef struct
+{
+    TreeStore *t;
+    TreeData *tree_data;
+    const View *v;
+    Canvas *canvas;
+    LodFrame *stack;
+    int depth;
+    int cap;
+} LodDraw;
+
+// Width of the subtree of i on the output
+static long long lod_footprint(const LodDraw *d, uint32_t i)
+{
+    return (long long)(d->t->span_x1[i] - d->t->span_x0[i]) * d->v->zoom / d->v->shrink;
+}
+
+static bool lod_meets(const LodDraw *d, uint32_t i)
+{
+    const TreeStore *t = d->t;
+    const View *v = d->v;
+    return t->span_x1[i] > v->x && t->span_x0[i] < v->x + v->w &&
+           t->span_y1[i] > v->y && t->draw_y[i] < v->y + v->h;
+}
+
+// n with a comma every three digits
+static void format_count(char *buf, size_t size, uint32_t n)
+{
+    char digits[16];
+    int len = snprintf(digits, sizeof(digits), "%u", n);
+    size_t o = 0;
+    for (int k = 0; k < len && o + 2 < size; k++)
+    {
+        if (k > 0 && (len - k) % 3 == 0)
+            buf[o++] = ',';
+        buf[o++] = digits[k];
+    }
+    buf[o] = '\0';
+}
+
+// Box over [x0, x1) x [y0, y1) of the layout with the counts in it, or
+// just their total when they do not fit. It grows to hold a line of text
+// if the rows are far enough apart, pitch being their distance.
+static void draw_aggregate(LodDraw *d, int x0, int y0, int x1, int y1, int pitch, uint32_t files, uint32_t dirs)
+{
+    int s = d->v->shrink;
+    int padd = d->tree_data->internal_padd;
+    int text_h = BITMAP_SIZE - 1;
+    int min_h = pitch / s - 1 < text_h + padd * 2 ? pitch / s - 1 : text_h + padd * 2;
+    x0 /= s;
+    y0 /= s;
+    x1 = (x1 - 1) / s + 1;
+    y1 = (y1 - 1) / s + 1;
+    if (y1 - y0 < min_h)
+        y1 = y0 + min_h;
+    fill_rect(d->canvas, x0, y0, x1 - x0, y1 - y0, COLOR_AGGREGATE);
+    if (y1 - y0 < text_h)
+        return;
+    // the label goes on the part of the box in view
+    if (x0 < d->canvas->x0)
+        x0 = d->canvas->x0;
+    if (x1 > d->canvas->x0 + d->canvas->w)
+        x1 = d->canvas->x0 + d->canvas->w;
+
+    char nf[16], nd[16], label[64];
+    format_count(nf, sizeof(nf), files);
+    format_count(nd, sizeof(nd), dirs);
+    if (files > 0 && dirs > 0)
+        snprintf(label, sizeof(label), "%s file%s / %s dir%s", nf, files == 1 ? "" : "s", nd, dirs == 1 ? "" : "s");
+    else if (dirs > 0)
+        snprintf(label, sizeof(label), "%s dir%s", nd, dirs == 1 ? "" : "s");
+    else
+        snprintf(label, sizeof(label), "%s file%s", nf, files == 1 ? "" : "s");
+    if ((int)strlen(label) * BITMAP_SIZE - 1 + padd * 2 > x1 - x0)
+        format_count(label, sizeof(label), files + dirs);
+    if ((int)strlen(label) * BITMAP_SIZE - 1 + padd * 2 <= x1 - x0)
+    {
+        int ty = (y1 - y0 - text_h) / 2 < padd ? (y1 - y0 - text_h) / 2 : padd;
+        draw_text_scale(d->canvas, x0 + padd, y0 + ty, label, 1);
+    }
+}
+
+// Draws i, then either a box for everything under it or queues the
+// children of it that may meet the view
+static bool lod_visit(LodDraw *d, uint32_t i)
+{
+    TreeStore *t = d->t;
+    const View *v = d->v;
+    if (v->shrink > 1)
+        draw_tree_node_shrunk(d->canvas, t, d->tree_data, i, v->shrink);
+    else
+        draw_tree_node(d->canvas, t, d->tree_data, i);
+
+    int n = t->child_cnt[i];
+    const uint32_t *c = t->children + t->child_start[i];
+    if (n == 0 || t->draw_y[c[0]] >= v->y + v->h)
+        return true;
+    // a box for a single node would hide it for nothing
+    if (lod_footprint(d, i) < v->lod && t->subtree_end[i] - i > 2)
+    {
+        draw_aggregate(d, t->reach_x0[c[0]], t->draw_y[c[0]], t->reach_x1[c[n - 1]], t->span_y1[i],
+                       t->draw_y[c[0]] - t->draw_y[i], t->files[i], t->dirs[i] - 1);
+        return true;
+    }
+
+    // first child reaching past the left edge, first one starting past the right
+    int lo = 0, hi = n;
+    while (lo < hi)
+    {
+        int m = (lo + hi) / 2;
+        if (t->reach_x1[c[m]] > v->x)
+            hi = m;
+        else
+            lo = m + 1;
+    }
+    int first = lo;
+    hi = n;
+    while (lo < hi)
+    {
+        int m = (lo + hi) / 2;
+        if (t->reach_x0[c[m]] >= v->x + v->w)
+            hi = m;
+        else
+            lo = m + 1;
+    }
+    if (first == lo)
+        return true;
+
+    if (d->depth == d->cap)
+    {
+        int cap = d->cap ? d->cap * 2 : 64;
+        LodFrame *stack = (LodFrame *)realloc(d->stack, sizeof(LodFrame) * cap);
+        if (!stack)
+        {
+            fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+            return false;
+        }
+        d->stack = stack;
+        d->cap = cap;
+    }
+    LodFrame *f = &d->stack[d->depth++];
+    f->p = i;
+    f->k = first;
+    f->end = lo;
+    return true;
+}
+
+// The view's part of the tree at the view's level of detail
+static bool draw_tree_lod(Canvas *canvas, TreeStore *t, TreeData *tree_data, const View *v)
+{
+    LodDraw d = {t, tree_data, v, canvas, NULL, 0, 0};
+    uint32_t root = v->root != NO_NODE ? v->root : 0;
+    bool ok = !lod_meets(&d, root) || lod_visit(&d, root);
+    while (ok && d.depth > 0)
+    {
+        LodFrame *f = &d.stack[d.depth - 1];
+        if (f->k == f->end)
+        {
+            d.depth--;
+            continue;
+        }
+
+        const uint32_t *c = t->children + t->child_start[f->p];
+        uint32_t i = c[f->k];
+        if (!lod_meets(&d, i))
+        {
+            f->k++;
+            continue;
+        }
+        if (lod_footprint(&d, i) >= v->lod)
+        {
+            f->k++;
+            ok = lod_visit(&d, i);
+            continue;
+        }
+
+        // the run of small siblings from i on
+        int x0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN, cnt = 0;
+        uint32_t files = 0, dirs = 0;
+        int k = f->k;
+        for (; k < f->end && lod_footprint(&d, c[k]) < v->lod; k++)
+        {
+            uint32_t s = c[k];
+            if (!lod_meets(&d, s))
+                continue;
+            if (t->span_x0[s] < x0)
+                x0 = t->span_x0[s];
+            if (t->span_x1[s] > x1)
+                x1 = t->span_x1[s];
+            if (t->span_y1[s] > y1)
+                y1 = t->span_y1[s];
+            files += t->files[s];
+            dirs += t->dirs[s];
+            cnt++;
+        }
+        f->k = k;
+        if (cnt == 1)
+            ok = lod_visit(&d, i);
+        else
+            draw_aggregate(&d, x0, t->draw_y[i], x1, y1, t->draw_y[i] - t->draw_y[f->p], files, dirs);
+    }
+    free(d.stack);
+    return ok;
+}
+
+// Draws the output rows [y, y + h) of the view into rows, stride bytes
+// apart. Just the nodes the grid finds in the rows' part of the view's
+// rectangle are drawn, or with a level of detail the ones down to it, so
+// the cost follows the view, not the tree. A zoom draws at 1:1 into src
+// (h / zoom rows of v->w pixels, y a multiple of the zoom) and repeats
+// every pixel, which is what the bitmap font does at that scale anyway.
+static bool render_view_rows(TreeStore *t, TreeData *tree_data, const View *v, int y, int h,
+                             unsigned char *rows, size_t stride, unsigned char *src)
+{
+    int w = tree_data->canvas_width;
+    int channels = tree_data->channels;
+    size_t src_stride = (size_t)v->w * channels;
+
+    // the layout rows under the output rows
+    View band = *v;
+    Canvas c;
+    if (v->zoom > 1)
+    {
+        band.y = v->y + y / v->zoom;
+        band.h = (h + v->zoom - 1) / v->zoom;
+        init_canvas(&c, tree_data, src, v->x, band.y, v->w, band.h, src_stride);
+    }
+    else if (v->shrink > 1)
+    {
+        int y0 = v->y / v->shrink + y;
+        int y1 = (y0 + h) * v->shrink;
+        band.y = y0 * v->shrink > v->y ? y0 * v->shrink : v->y;
+        band.h = (y1 < v->y + v->h ? y1 : v->y + v->h) - band.y;
+        init_canvas(&c, tree_data, rows, v->x / v->shrink, y0, w, h, stride);
+    }
+    else
+    {
+        band.y = v->y + y;
+        band.h = h;
+        init_canvas(&c, tree_data, rows, v->x, band.y, w, h, stride);
+    }
+    fill_rect(&c, c.x0, c.y0, c.w, c.h, COLOR_WHITE);
+
+    // the level of detail merges siblings across the whole view, so it
+    // walks all of it and the canvas keeps the rows
+    if (v->lod > 0 ? !draw_tree_lod(&c, t, tree_data, v) : !draw_view_nodes(&c, t, tree_data, &band))
+    {
+        return false;
+    }
+
+    if (v->zoom > 1)
+    {
+        size_t px = (size_t)channels;
+        for (int r = 0; r < h; r++)
+        {
+            const unsigned char *s = src + (size_t)(r / v->zoom) * src_stride;
+            unsigned char *d = rows + (size_t)r * stride;
+            if (r % v->zoom != 0)
+            {
+                memcpy(d, d - stride, (size_t)w * px);
+                continue;
+            }
+            for (int x = 0; x < w; x++)
+                memcpy(d + x * px, s + (x / v->zoom) * px, px);
+        }
+    }
+    return true;
+}
+
+// Renders only the view into a new canvas of its output size
+bool render_view(TreeStore *t, TreeData *tree_data, const View *v, Canvas *canvas)
+{
+    int w = tree_data->canvas_width;
+    int h = tree_data->canvas_height;
+    size_t stride = (size_t)w * tree_data->channels;
+    unsigned char *img = (unsigned char *)malloc(stride * h);
+    unsigned char *src = v->zoom > 1 ? (unsigned char *)malloc((size_t)v->w * tree_data->channels * v->h) : NULL;
+    if (!img || (v->zoom > 1 && !src))
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY FOR IMG\n");
+        free(img);
+        free(src);
+        return false;
+    }
+
+    bool ok = render_view_rows(t, tree_data, v, 0, h, img, stride, src);
+    free(src);
+    if (!ok)
+    {
+        free(img);
+        return false;
+    }
+    init_canvas(canvas, tree_data, img, 0, 0, w, h, stride);
+    return true;
+}
+
+// render_view() a band of about tile output rows at a time, each handed
+// to emit() as render_tiled() does. Bands hold whole zoomed rows.
+bool render_view_tiled(TreeStore *t, TreeData *tree_data, const View *v, int tile, band_fn emit, void *user)
+{
+    int w = tree_data->canvas_width;
+    int band_h = (tile + v->zoom - 1) / v->zoom * v->zoom;
+    size_t stride = (size_t)w * tree_data->channels;
+    unsigned char *band = (unsigned char *)malloc(stride * band_h);
+    unsigned char *src = v->zoom > 1 ? (unsigned char *)malloc((size_t)v->w * tree_data->channels * (band_h / v->zoom)) : NULL;
+    if (!band || (v->zoom > 1 && !src))
+    {
+        fprintf(stderr, "ERROR: OUT OF MEMORY\n");
+        free(band);
+        free(src);
+        return false;
+    }
+
+    bool ok = true;
+    for (int y = 0; ok && y < tree_data->canvas_height; y += band_h)
+    {
+        int h = tree_data->canvas_height - y < band_h ? tree_data->canvas_height - y : band_h;
+        ok = render_view_rows(t, tree_data, v, y, h, band, stride, src);
+        if (ok)
+            emit(user, band, y, h, stride);
+    }
+
+    free(band);
+    free(src);
+    return ok;
+}
+
+// Feeds every band straight into the PNG encoder
+static void write_png_band(void *user, const unsigned char *rows, int y, int h, size_t stride)
+{
+    (void)y;
+    png_stream_write_rows((PngStream *)user, rows, h, stride);
+}
+
+// RGB or palette PNG, whichever the tree was drawn in
+static PngStream *open_tree_png(const char *path, TreeData *tree_data, PngFilterMode filter)
+{
+    int w = tree_data->canvas_width, h = tree_data->canvas_height;
+    const Palette *pal = &tree_data->palette;
+    PngStream *png = tree_data->channels == 1
+                         ? png_stream_open_indexed(path, w, h, palette_bit_depth(pal), pal->colors, pal->cnt)
+                         : png_stream_open(path, w, h, 3);
+    if (png)
+    {
+        png_stream_set_filter(png, filter);
+    }
+    return png;
+}
+
+int main(int argc, char **argv)
+{
+#ifdef _WIN32
+    const char *start_file = "C:\\Users\\marco\\Programming\\DirectoryTree";
+    const char *out_file = "C:\\Users\\marco\\Programming\\DirectoryTree\\tree.png";
+#else
+    const char *start_file = ".";
+    const char *out_file = "tree.png";
+#endif
+    ScanOptions scan = {false, false, true};
+    int threads = 0; // <= 0 uses every online cpu
+    bool tiled = false;
+    PngFilterMode filter = PNG_FILTER_ADAPTIVE;
+    bool rgb = false;
+    int max_w = MAX_IMG_WIDTH;
+    int max_h = MAX_IMG_HEIGHT;
+    int max_label = DEFAULT_MAX_LABEL;
+    View view = {0, 0, 0, 0, 1, 1, NO_NODE, 0};
+    bool cropped = false;
+    const char *subtree = NULL;
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--sort") == 0)
+        {
+            scan.sorted = true;
+        }
+        else if (strcmp(argv[i], "--stat") == 0)
+        {
+            scan.stat = true;
+        }
+        else if (strcmp(argv[i], "--no-uring") == 0)
+        {
+            scan.use_uring = false;
+        }
+        else if (strcmp(argv[i], "--tiled") == 0)
+        {
+            tiled = true;
+        }
+        else if (strcmp(argv[i], "--flat-filter") == 0)
+        {
+            filter = PNG_FILTER_FLAT;
+        }
+        else if (strcmp(argv[i], "--rgb") == 0)
+        {
+            rgb = true;
+        }
+        else if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc &&
+                 sscanf(argv[i + 1], "%dx%d", &max_w, &max_h) == 2 && max_w > 0 && max_h > 0)
+        {
+            i++;
+        }
+        else if (strcmp(argv[i], "--max-label") == 0 && i + 1 < argc &&
+                 sscanf(argv[i + 1], "%d", &max_label) == 1 &&
+                 (max_label == 0 || max_label > LABEL_ELLIPSIS_LEN))
+        {
+            i++;
+        }
+        else if (strcmp(argv[i], "--crop") == 0 && i + 1 < argc &&
+                 sscanf(argv[i + 1], "%dx%d+%d+%d", &view.w, &view.h, &view.x, &view.y) == 4 &&
+                 view.w > 0 && view.h > 0 && view.x >= 0 && view.y >= 0)
+        {
+            cropped = true;
+            i++;
+        }
+        else if (strcmp(argv[i], "--lod") == 0 && i + 1 < argc &&
+                 sscanf(argv[i + 1], "%d", &view.lod) == 1 && view.lod > 0)
+        {
+            i++;
+        }
+        else if (strcmp(argv[i], "--subtree") == 0 && i + 1 < argc)
+        {
+            subtree = argv[++i];
+        }
+        else if (strcmp(argv[i], "--zoom") == 0 && i + 1 < argc &&
+                 sscanf(argv[i + 1], "%d/%d", &view.zoom, &view.shrink) >= 1 &&
+                 ((view.shrink == 1 && view.zoom > 0 && view.zoom <= 64) || (view.zoom == 1 && view.shrink > 0)))
+        {
+            i++;
+        }
+        else if (argv[i][0] == '-')
+        {
+            fprintf(stderr, "usage: %s [-j threads] [--sort] [--stat] [--no-uring] [--max-size WxH] [--max-label N] [--tiled] [--flat-filter] [--rgb] [--crop WxH+X+Y] [--subtree path] [--zoom N|1/N] [--lod px] [start_dir] [out.png]\n", argv[0]);
+            return 1;
+        }
+        else if (positional++ == 0)
+        {
+            start_file = argv[i];
+        }
+        else
+        {
+            out_file = argv[i];
+        }
+    }
+
+    // one pool for the scan, the layout, the drawing and the deflate
+    Pool *pool = pool_create(threads);
+#ifndef _WIN32
+    pzlib_set_pool(pool);
+#endif
+    stbiw_filter_mode = filter;
+
+    NodeArena mem;
+    node_arena_init(&mem);
+
+    Node *root = NULL;
+    TreeData *tree_data = (TreeData *)malloc(sizeof(TreeData));
+    if (tree_data == NULL)
+    {
+        fprintf(stderr, "ERRROR: NOT ENOUGHT MEMORY FOR TreeData");
+        return 1;
+    }
+    tree_data->max_canvas_width = max_w;
+    tree_data->max_canvas_height = max_h;
+    tree_data->channels = rgb ? 3 : 1;
+    tree_data->pool = pool;
+
+    // save first parent
+    if (root == NULL)
     {
         char name[512];
         const char *base = basename(start_file);
         strncpy(name, base, sizeof(name) - 1);
         name[sizeof(name) - 1] = '\0';
-        root = new_node(name, PARENT);
+        root = new_node(&mem, name, PARENT);
     }
 
-    tranverse(start_file, root);
-
-    int w = IMG_WIDTH;
-    int h = IMG_HEIGHT;
+    tranverse_parallel(&mem, start_file, root, scan, pool);
 
-    unsigned char *img = malloc(IMG_WIDTH * IMG_HEIGHT * 3);
-    if (img == NULL)
+    TreeStore *store = tree_store_build(root, max_label);
+    node_arena_free(&mem);
+    if (store == NULL)
     {
-        fprintf(stderr, "ERROR: OUT OF MEMORY FOR IMG");
         return 1;
     }
 
-    load_tree(root, tree_data, img);
+    if (cropped || subtree || view.zoom != 1 || view.shrink != 1 || view.lod > 0)
+    {
+        layout_tree(store, tree_data);
+        if (subtree)
+        {
+            view.root = tree_store_find(store, subtree);
+            if (view.root == NO_NODE)
+            {
+                fprintf(stderr, "ERROR: NO %s IN THE TREE\n", subtree);
+                return 1;
+            }
+        }
+        if (!view_resolve(&view, store, tree_data, cropped))
+        {
+            return 1;
+        }
+        printf("view: %dx%d+%d+%d\n", view.w, view.h, view.x, view.y);
+    }
+    else if (tiled)
+    {
+        layout_tree(store, tree_data);
+    }
+
+    if (tiled)
+    {
+        printf("canvas: %dx%d (tiled)\n", tree_data->canvas_width, tree_data->canvas_height);
+
+        PngStream *png = open_tree_png(out_file, tree_data, filter);
+        if (png == NULL)
+        {
+            return 1;
+        }
+        bool ok = view.w > 0 ? render_view_tiled(store, tree_data, &view, TILE_SIZE, write_png_band, png)
+                             : render_tiled(store, tree_data, TILE_SIZE, write_png_band, png);
+        if (!png_stream_close(png))
+        {
+            fprintf(stderr, "ERROR: FAILED TO WRITE PNG\n");
+            ok = false;
+        }
+
+        tree_store_free(store);
+        free(tree_data);
+        pool_destroy(pool);
+        return ok ? 0 : 1;
+    }
+
+    Canvas canvas;
+    if (view.w > 0 ? !render_view(store, tree_data, &view, &canvas) : !load_tree(store, tree_data, &canvas))
+    {
+        return 1;
+    }
 
     printf("\n\nTREE\n\n");
     printf("tree_data: %i\n", tree_data->parent_cnt);
-    // walk(root, 0, false);
-    // walk_draw(tree_data->node, 0, true);
-    // walk_draw_verbose(tree_data->node, 0, true);
-    int ok = stbi_write_png("C:\\Users\\marco\\Programming\\DirectoryTree\\tree.png", w, h, 3, img, w * 3);
+    // walk(store, false);
+    // walk_draw(store, true);
+    // walk_draw_verbose(store, true);
+    printf("canvas: %dx%d\n", canvas.w, canvas.h);
+    // The palette canvas goes to png_stream (stb_image_write has no palette
+    // PNGs), --rgb to stbi_write_png(); --tiled streamed its bands into
+    // png_stream above. Each of them deflates on the pool through pzlib.h.
+    bool ok;
+    if (canvas.channels == 1)
+    {
+        PngStream *png = open_tree_png(out_file, tree_data, filter);
+        ok = png && png_stream_write_rows(png, canvas.img, canvas.h, canvas.stride);
+        ok = png_stream_close(png) && ok;
+    }
+    else
+    {
+        ok = stbi_write_png(out_file, canvas.w, canvas.h, 3, canvas.img, (int)canvas.stride) != 0;
+    }
     if (!ok)
     {
         fprintf(stderr, "ERROR: FAILED TO WRITE PNG\n");
         return 1;
     }
 
-    free(img);
-    free_draw_tree(tree_data->node);
-    free_node(root);
+    free(canvas.img);
+    tree_store_free(store);
     free(tree_data);
+    pool_destroy(pool);
 
     return 0;
 }
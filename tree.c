@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 #include "bitmap.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
@@ -36,9 +37,28 @@ void fill_rect(unsigned char *img, int w,
                int x, int y, int rw, int rh,
                unsigned int color)
 {
-    for (int j = 0; j < rh; j++)
-        for (int i = 0; i < rw; i++)
-            set_pixel(img, w, x + i, y + j, color);
+    // clip once, then fill whole rows
+    if (x < 0)
+    {
+        rw += x;
+        x = 0;
+    }
+    if (y < 0)
+    {
+        rh += y;
+        y = 0;
+    }
+    if (x + rw > w)
+        rw = w - x;
+    if (rw <= 0 || rh <= 0)
+        return;
+
+    // first row a pixel at a time, the others are copies of it
+    unsigned char *row = img + ((size_t)y * w + x) * 3;
+    for (int i = 0; i < rw; i++)
+        set_pixel(row, rw, i, 0, color);
+    for (int j = 1; j < rh; j++)
+        memcpy(row + (size_t)j * w * 3, row, (size_t)rw * 3);
 }
 
 void draw_line(unsigned char *img, int w,
@@ -163,8 +183,7 @@ int main()
     int w = 512;
     int h = 512;
     unsigned char *img = malloc(w * h * 3);
-    for (int i = 0; i < w * h * 3; i++)
-        img[i] = 255;
+    memset(img, 255, (size_t)w * h * 3);
 
     char name[512] = "ROOT.TXT";
     